@@ -0,0 +1,214 @@
+#ifndef FORMAL_LANGUAGE_APPROXIMATE_H
+#define FORMAL_LANGUAGE_APPROXIMATE_H
+
+// Приближённый поиск: самое длинное подслово u, которое отличается от какого-либо подслова
+// слова из L не больше чем на k правок (вставка, удаление или замена символа). Автомат подслов
+// языка (позиционный автомат, в котором все позиции начальные и конечные) моделируется по
+// схеме Ву -- Манбера с k + 1 уровнями ошибок: уровень d -- множество позиций, в которых может
+// заканчиваться путь, отстоящий от прочитанного отрезка не больше чем на d правок, по биту на
+// позицию. Переходы позиционного автомата, в отличие от образца-строки, не сдвиг, поэтому
+// последователи множества берутся из таблиц для каждых 8 позиций (по 256 вариантов), а у
+// больших выражений -- объединением последователей отдельных позиций
+
+#include <vector>
+#include <algorithm>
+
+#include "common.h"
+#include "automaton.h"
+
+// Множества позиций автомата по 64 позиции в слове и последователи при чтении в одну сторону
+struct PositionSets {
+private:
+    static const ulong CHUNK_BITS = 8;
+    static const ulong MAX_TABLE_POSITIONS = 1024; // таблицы не больше 4 МБ
+
+    ulong positionCount;
+    ulong wordCount;
+
+    std::vector<ulong> successors;
+    // successors[position * wordCount, (position + 1) * wordCount) -- последователи позиции
+
+    std::vector<ulong> chunkTable;
+    // chunkTable[((chunk * 256 + byte) * wordCount ...)] -- объединение последователей позиций
+    // chunk * 8 + i для всех битов i байта byte; пусто, если позиций больше MAX_TABLE_POSITIONS
+
+    std::vector<ulong> letterMasks;
+    // letterMasks[letter * wordCount ...] -- позиции с буквой индекса letter
+
+    std::vector<ulong> allPositions;
+
+public:
+    // reversed == false -- последователи по переходам автомата, true -- предшественники
+    PositionSets(const AutomatonView &automaton, bool reversed) :
+            positionCount(automaton.positionCount), wordCount((automaton.positionCount + 63) / 64),
+            successors(automaton.positionCount * wordCount, 0), letterMasks(ALPHABET_SIZE * wordCount, 0),
+            allPositions(wordCount, 0) {
+        for (ulong position = 0; position < positionCount; ++position) {
+            allPositions[position / 64] |= 1UL << (position % 64);
+            ulong letter = PositionAutomaton::letterIndex(automaton.letters[position]);
+            letterMasks[letter * wordCount + position / 64] |= 1UL << (position % 64);
+            for (letter = 0; letter < ALPHABET_SIZE; ++letter) {
+                for (const ulong *next = automaton.transitionsBegin(position, letter);
+                     next != automaton.transitionsEnd(position, letter); ++next) {
+                    ulong from = reversed ? *next : position;
+                    ulong to = reversed ? position : *next;
+                    successors[from * wordCount + to / 64] |= 1UL << (to % 64);
+                }
+            }
+        }
+
+        if (positionCount > MAX_TABLE_POSITIONS) {
+            return;
+        }
+        ulong chunkCount = (positionCount + CHUNK_BITS - 1) / CHUNK_BITS;
+        chunkTable.assign(chunkCount * 256 * wordCount, 0);
+        for (ulong chunk = 0; chunk < chunkCount; ++chunk) {
+            for (ulong byte = 1; byte < 256; ++byte) {
+                ulong lowest = static_cast<ulong>(__builtin_ctzl(byte));
+                ulong position = chunk * CHUNK_BITS + lowest;
+                ulong *entry = &chunkTable[(chunk * 256 + byte) * wordCount];
+                const ulong *rest = &chunkTable[(chunk * 256 + (byte & (byte - 1))) * wordCount];
+                for (ulong i = 0; i < wordCount; ++i) {
+                    entry[i] = rest[i] | (position < positionCount ? successors[position * wordCount + i] : 0);
+                }
+            }
+        }
+    }
+
+    ulong getWordCount() const {
+        return wordCount;
+    }
+
+    const ulong *letterMask(ulong letter) const {
+        return &letterMasks[letter * wordCount];
+    }
+
+    // out = последователи позиций set; fromStart -- путь ещё пуст, и следующей может быть любая позиция
+    void follow(const ulong *set, bool fromStart, ulong *out) const {
+        if (fromStart) {
+            std::copy(allPositions.begin(), allPositions.end(), out);
+            return;
+        }
+        std::fill(out, out + wordCount, 0);
+        if (!chunkTable.empty()) {
+            for (ulong word = 0; word < wordCount; ++word) {
+                for (ulong shift = 0; shift < 64 && set[word] >> shift != 0; shift += CHUNK_BITS) {
+                    ulong byte = (set[word] >> shift) & 255;
+                    if (byte == 0) {
+                        continue;
+                    }
+                    const ulong *entry = &chunkTable[((word * 64 + shift) / CHUNK_BITS * 256 + byte) * wordCount];
+                    for (ulong i = 0; i < wordCount; ++i) {
+                        out[i] |= entry[i];
+                    }
+                }
+            }
+            return;
+        }
+        for (ulong word = 0; word < wordCount; ++word) {
+            for (ulong bits = set[word]; bits != 0; bits &= bits - 1) {
+                ulong position = word * 64 + static_cast<ulong>(__builtin_ctzl(bits));
+                const ulong *entry = &successors[position * wordCount];
+                for (ulong i = 0; i < wordCount; ++i) {
+                    out[i] |= entry[i];
+                }
+            }
+        }
+    }
+};
+
+struct ApproximateMatcher {
+private:
+    ulong edits;
+    PositionSets forward;
+    PositionSets backward;
+
+    std::vector<ulong> states;
+    std::vector<ulong> nextStates;
+    std::vector<ulong> oldFollowers;
+    std::vector<ulong> newFollowers;
+    // по edits + 1 множеству позиций: уровни ошибок до и после очередного символа
+    // и последователи этих уровней
+
+    // Длина самого длинного отрезка не длиннее limit, который начинается символом word[from]
+    // (reversed == false, чтение вправо) или заканчивается символом word[from - 1] (reversed == true,
+    // чтение влево) и отстоит от какого-либо пути автомата не больше чем на edits правок
+    ulong longestRun(const PositionSets &sets, string_view word, ulong from, bool reversed, ulong limit) {
+        ulong wordCount = sets.getWordCount();
+        ulong available = std::min(limit, reversed ? from : word.length() - from);
+        std::fill(states.begin(), states.end(), 0);
+
+        for (ulong consumed = 0; consumed < available; ++consumed) {
+            char character = reversed ? word[from - consumed - 1] : word[from + consumed];
+            const ulong *mask = sets.letterMask(PositionAutomaton::letterIndex(character));
+            bool alive = consumed + 1 <= edits;
+
+            for (ulong level = 0; level <= edits; ++level) {
+                ulong *current = &states[level * wordCount];
+                ulong *next = &nextStates[level * wordCount];
+                ulong *oldFollow = &oldFollowers[level * wordCount];
+                // Путь ещё пуст, пока все прочитанные символы -- вставки
+                sets.follow(current, consumed <= level, oldFollow);
+                for (ulong i = 0; i < wordCount; ++i) {
+                    next[i] = oldFollow[i] & mask[i];
+                }
+                if (level > 0) {
+                    // Вставка символа, замена, удаление символа пути и всё, что возможно с меньшим числом правок
+                    const ulong *lowerCurrent = &states[(level - 1) * wordCount];
+                    const ulong *lowerOldFollow = &oldFollowers[(level - 1) * wordCount];
+                    const ulong *lowerNext = &nextStates[(level - 1) * wordCount];
+                    ulong *lowerNewFollow = &newFollowers[(level - 1) * wordCount];
+                    sets.follow(lowerNext, consumed + 1 <= level - 1, lowerNewFollow);
+                    for (ulong i = 0; i < wordCount; ++i) {
+                        next[i] |= lowerCurrent[i] | lowerOldFollow[i] | lowerNewFollow[i] | lowerNext[i];
+                    }
+                }
+            }
+
+            const ulong *top = &nextStates[edits * wordCount];
+            for (ulong i = 0; i < wordCount && !alive; ++i) {
+                alive = top[i] != 0;
+            }
+            if (!alive) {
+                return consumed;
+            }
+            states.swap(nextStates);
+        }
+        return available;
+    }
+
+public:
+    ApproximateMatcher(const AutomatonView &automaton, ulong edits) :
+            edits(edits), forward(automaton, false), backward(automaton, true),
+            states((edits + 1) * forward.getWordCount()), nextStates(states.size()),
+            oldFollowers(states.size()), newFollowers(states.size()) {}
+
+    // Подходящие отрезки замкнуты относительно взятия подотрезка. Для очередного конца end
+    // проверяется, подходит ли отрезок длины best + 1, заканчивающийся символом end - 1: он
+    // читается влево. Если подошло только length символов, то никакой подходящий отрезок не
+    // содержит символы end - length - 1 и end - 1 вместе, и следующий конец, у которого отрезок
+    // длины best + 1 может подойти, -- end + best + 1 - length. Если подошёл весь отрезок, от самого
+    // раннего начала start подходящего отрезка с этим концом отрезок читается вправо, сколько
+    // подходит, и это новый best; более длинные отрезки с концом до start + best содержали бы
+    // отрезок, начинающийся раньше start и заканчивающийся в end - 1
+    ulong longestFactor(string_view word) {
+        ulong best = 0;
+        if (word.empty()) {
+            return best;
+        }
+        validateWord(word);
+        for (ulong end = 1; end <= word.length();) {
+            ulong length = longestRun(backward, word, end, true, best + 1);
+            if (length <= best) {
+                end += best + 1 - length;
+                continue;
+            }
+            ulong start = end - longestRun(backward, word, end, true, end);
+            best = longestRun(forward, word, start, false, word.length() - start);
+            end = start + best + 1;
+        }
+        return best;
+    }
+};
+
+#endif // FORMAL_LANGUAGE_APPROXIMATE_H
@@ -0,0 +1,633 @@
+#ifndef FORMAL_LANGUAGE_AUTOMATON_H
+#define FORMAL_LANGUAGE_AUTOMATON_H
+
+// Автомат подслов языка выражения и скомпилированные выражения
+
+#include <vector>
+#include <stack>
+#include <deque>
+#include <memory>
+#include <algorithm>
+#include <climits>
+#include <cstring>
+#include <fcntl.h>
+
+#include "common.h"
+#include "input.h"
+
+// Таблицы автомата подслов без владения памятью: указывают либо в векторы
+// PositionAutomaton, либо в отображённый в память файл скомпилированного выражения
+struct AutomatonView {
+    ulong positionCount;
+
+    const char *letters;
+    // letters[position] -- буква, стоящая в позиции position
+
+    const ulong *transitionOffsets;
+    const ulong *transitionTargets;
+    // переходы из позиции p по букве с индексом l лежат в transitionTargets на полуинтервале
+    // [transitionOffsets[p * ALPHABET_SIZE + l], transitionOffsets[p * ALPHABET_SIZE + l + 1])
+
+    const ulong *letterOffsets;
+    const ulong *positionsByLetter;
+    // позиции с буквой индекса l лежат в positionsByLetter на полуинтервале
+    // [letterOffsets[l], letterOffsets[l + 1])
+
+    ulong transitionCount() const {
+        return transitionOffsets[positionCount * ALPHABET_SIZE];
+    }
+
+    const ulong *transitionsBegin(ulong position, ulong letter) const {
+        return transitionTargets + transitionOffsets[position * ALPHABET_SIZE + letter];
+    }
+
+    const ulong *transitionsEnd(ulong position, ulong letter) const {
+        return transitionTargets + transitionOffsets[position * ALPHABET_SIZE + letter + 1];
+    }
+
+    const ulong *positionsBegin(ulong letter) const {
+        return positionsByLetter + letterOffsets[letter];
+    }
+
+    const ulong *positionsEnd(ulong letter) const {
+        return positionsByLetter + letterOffsets[letter + 1];
+    }
+};
+
+// Позиционный автомат (автомат Глушкова) регулярного выражения.
+// Состояния -- позиции, то есть вхождения букв в выражение. В выражениях
+// нет символа пустого языка, поэтому каждая позиция встречается в каком-то
+// слове из L, и автомат подслов языка L получается из позиционного, если
+// все позиции сделать одновременно начальными и конечными
+struct PositionAutomaton {
+private:
+
+    struct Fragment {
+        std::vector<ulong> first; // позиции, с которых могут начинаться слова фрагмента
+        std::vector<ulong> last;  // позиции, которыми могут заканчиваться слова фрагмента
+        bool nullable;            // пустое слово принадлежит языку фрагмента
+    };
+
+    // Смысл таблиц описан в AutomatonView
+    std::vector<char> letters;
+    std::vector<ulong> transitionOffsets;
+    std::vector<ulong> transitionTargets;
+    std::vector<ulong> letterOffsets;
+    std::vector<ulong> positionsByLetter;
+
+    static void append(std::vector<ulong> &to, const std::vector<ulong> &from) {
+        to.insert(to.end(), from.begin(), from.end());
+    }
+
+    static Fragment popFragment(std::stack<Fragment> &fragments) {
+        Fragment fragment = fragments.top();
+        fragments.pop();
+        return fragment;
+    }
+
+    void buildTransitions(std::vector<std::vector<ulong> > &follow) {
+        transitionOffsets.assign(letters.size() * ALPHABET_SIZE + 1, 0);
+
+        for (ulong position = 0; position < letters.size(); ++position) {
+            std::sort(follow[position].begin(), follow[position].end());
+            follow[position].erase(std::unique(follow[position].begin(), follow[position].end()),
+                                   follow[position].end());
+
+            for (ulong letter = 0; letter < ALPHABET_SIZE; ++letter) {
+                transitionOffsets[position * ALPHABET_SIZE + letter] = transitionTargets.size();
+                for (ulong next : follow[position]) {
+                    if (letterIndex(letters[next]) == letter) {
+                        transitionTargets.push_back(next);
+                    }
+                }
+            }
+        }
+        transitionOffsets.back() = transitionTargets.size();
+
+        letterOffsets.assign(ALPHABET_SIZE + 1, 0);
+        for (ulong letter = 0; letter < ALPHABET_SIZE; ++letter) {
+            letterOffsets[letter] = positionsByLetter.size();
+            for (ulong position = 0; position < letters.size(); ++position) {
+                if (letterIndex(letters[position]) == letter) {
+                    positionsByLetter.push_back(position);
+                }
+            }
+        }
+        letterOffsets.back() = positionsByLetter.size();
+    }
+
+public:
+
+    // Индекс буквы в алфавите {a, b, c}; для остальных символов -- ALPHABET_SIZE
+    static ulong letterIndex(char character) {
+        if (character >= 'a' && character <= 'c') {
+            return static_cast<ulong>(character - 'a');
+        }
+        return ALPHABET_SIZE;
+    }
+
+    explicit PositionAutomaton(string_view expression) {
+        if (expression.empty()) {
+            throw ParseException("Expression is empty");
+        }
+
+        std::vector<std::vector<ulong> > follow;
+        // follow[position] -- позиции, которые могут идти в слове сразу после position
+        std::stack<Fragment> fragments;
+
+        for (char character : expression) {
+            if (character == '+' || character == '.') {
+                if (fragments.size() < 2) {
+                    throw ParseException("Missing operands");
+                }
+                Fragment right = popFragment(fragments);
+                Fragment left = popFragment(fragments);
+                Fragment result;
+
+                if (character == '+') {
+                    result.first = left.first;
+                    append(result.first, right.first);
+                    result.last = left.last;
+                    append(result.last, right.last);
+                    result.nullable = left.nullable || right.nullable;
+                } else {
+                    for (ulong position : left.last) {
+                        append(follow[position], right.first);
+                    }
+                    result.first = left.first;
+                    if (left.nullable) {
+                        append(result.first, right.first);
+                    }
+                    result.last = right.last;
+                    if (right.nullable) {
+                        append(result.last, left.last);
+                    }
+                    result.nullable = left.nullable && right.nullable;
+                }
+                fragments.push(result);
+            } else if (character == '*') {
+                if (fragments.empty()) {
+                    throw ParseException("Missing operands");
+                }
+                Fragment operand = popFragment(fragments);
+                for (ulong position : operand.last) {
+                    append(follow[position], operand.first);
+                }
+                operand.nullable = true;
+                fragments.push(operand);
+            } else if (character == EPSILON) {
+                fragments.push(Fragment{std::vector<ulong>(), std::vector<ulong>(), true});
+            } else if (letterIndex(character) < ALPHABET_SIZE) {
+                ulong position = letters.size();
+                letters.push_back(character);
+                follow.emplace_back();
+                fragments.push(Fragment{std::vector<ulong>(1, position), std::vector<ulong>(1, position), false});
+            } else {
+                string message = "Unknown symbol in expression: " + string(1, character);
+                throw ParseException(message);
+            }
+        }
+
+        if (fragments.size() > 1) {
+            throw ParseException("Too much operands");
+        }
+        if (fragments.size() < 1) {
+            throw ParseException("Missing operands");
+        }
+
+        buildTransitions(follow);
+    }
+
+    ulong positionCount() const {
+        return letters.size();
+    }
+
+    // Память, занятая таблицами автомата
+    ulong byteSize() const {
+        return letters.capacity() * sizeof(char)
+               + (transitionOffsets.capacity() + transitionTargets.capacity()
+                  + letterOffsets.capacity() + positionsByLetter.capacity()) * sizeof(ulong);
+    }
+
+    AutomatonView view() const {
+        return AutomatonView{letters.size(), letters.data(), transitionOffsets.data(), transitionTargets.data(),
+                             letterOffsets.data(), positionsByLetter.data()};
+    }
+};
+
+// Отслеживает самое длинное подслово уже прочитанной части слова, которое является
+// подсловом какого-либо слова из L. Слово подаётся по одному символу, память зависит
+// только от размера выражения (и от ширины окна, если оно задано), но не от длины слова
+struct FactorTracker {
+private:
+    static constexpr ulong NO_START = ULONG_MAX;
+
+    AutomatonView automaton;
+
+    std::vector<ulong> earliestStart;
+    // earliestStart[position] == s <=> s -- наименьшее начало такое, что отрезок прочитанного
+    // слова [s, consumed) читается в автомате подслов путём, заканчивающимся в позиции position
+
+    std::vector<ulong> nextStart;
+
+    ulong consumed;
+    // число прочитанных символов
+
+    ulong longest;
+    // длина самого длинного найденного подслова без ограничения на окно
+
+    ulong window;
+    // ширина окна: учитываются только подслова последних window символов; 0 -- без ограничения
+
+    std::deque<std::pair<ulong, ulong> > candidates;
+    // пары (конец, начало) самых длинных подслов, заканчивающихся в окне. Начала не убывают
+    // с ростом конца, поэтому подслово, которое не длиннее какого-то более позднего, можно
+    // забыть, и длины в очереди строго убывают
+
+    ulong crossedEnd;
+    // наибольший конец подслова из candidates, начало которого уже вышло за левую границу окна
+
+    ulong windowBegin() const {
+        return consumed > window ? consumed - window : 0;
+    }
+
+    void record(ulong start) {
+        ulong length = consumed - start;
+        longest = max(longest, length);
+
+        if (window == 0 || length == 0) {
+            return;
+        }
+        while (!candidates.empty() && candidates.back().first - candidates.back().second <= length) {
+            candidates.pop_back();
+        }
+        candidates.push_back(std::make_pair(consumed, start));
+    }
+
+    void dropExpiredCandidates() {
+        while (!candidates.empty() && candidates.front().second < windowBegin()) {
+            crossedEnd = max(crossedEnd, candidates.front().first);
+            candidates.pop_front();
+        }
+    }
+
+public:
+
+    FactorTracker(const AutomatonView &automaton, ulong window) :
+            automaton(automaton), earliestStart(automaton.positionCount, NO_START),
+            nextStart(automaton.positionCount, NO_START), consumed(0), longest(0),
+            window(window), crossedEnd(0) {}
+
+    // Символы вне алфавита {a, b, c} разрывают слово: подслово не может их содержать
+    void advance(char character) {
+        ulong letter = PositionAutomaton::letterIndex(character);
+
+        if (letter == ALPHABET_SIZE) {
+            std::fill(earliestStart.begin(), earliestStart.end(), NO_START);
+            ++consumed;
+            dropExpiredCandidates();
+            return;
+        }
+
+        std::fill(nextStart.begin(), nextStart.end(), NO_START);
+        for (const ulong *position = automaton.positionsBegin(letter);
+             position != automaton.positionsEnd(letter); ++position) {
+            nextStart[*position] = consumed;
+        }
+
+        for (ulong position = 0; position < earliestStart.size(); ++position) {
+            if (earliestStart[position] == NO_START) {
+                continue;
+            }
+            for (const ulong *next = automaton.transitionsBegin(position, letter);
+                 next != automaton.transitionsEnd(position, letter); ++next) {
+                nextStart[*next] = std::min(nextStart[*next], earliestStart[position]);
+            }
+        }
+
+        earliestStart.swap(nextStart);
+        ++consumed;
+
+        ulong start = consumed;
+        for (ulong candidate : earliestStart) {
+            start = std::min(start, candidate);
+        }
+        record(start);
+        dropExpiredCandidates();
+    }
+
+    void advance(const char *data, ulong size) {
+        for (ulong i = 0; i < size; ++i) {
+            advance(data[i]);
+        }
+    }
+
+    ulong longestFactor() const {
+        if (window == 0) {
+            return longest;
+        }
+
+        ulong answer = crossedEnd > windowBegin() ? crossedEnd - windowBegin() : 0;
+        if (!candidates.empty()) {
+            answer = max(answer, candidates.front().first - candidates.front().second);
+        }
+        return answer;
+    }
+};
+
+// Каноническая запись выражения в обратной польской записи: одинаковые по построению
+// выражения получают одну и ту же запись. Цепочки объединений сортируются и очищаются
+// от повторов, 1 в конкатенации отбрасывается, (e*)* и 1* сокращаются
+inline string canonicalizeExpression(string_view expression) {
+    struct Term {
+        string rpn;
+        std::vector<string> alternatives; // непусто <=> терм является объединением
+    };
+
+    if (expression.empty()) {
+        throw ParseException("Expression is empty");
+    }
+
+    std::stack<Term> terms;
+
+    for (char character : expression) {
+        if (character == '+' || character == '.') {
+            if (terms.size() < 2) {
+                throw ParseException("Missing operands");
+            }
+            Term right = terms.top();
+            terms.pop();
+            Term left = terms.top();
+            terms.pop();
+            Term result;
+
+            if (character == '.') {
+                // 1 отбрасывается вместе с конкатенацией: второй операнд остаётся тем же
+                // термом, и объединение в нём продолжает цепочку объединений снаружи
+                result = left.rpn == string(1, EPSILON) ? right
+                       : right.rpn == string(1, EPSILON) ? left
+                       : Term{left.rpn + right.rpn + '.', std::vector<string>()};
+            } else {
+                for (const Term *operand : {&left, &right}) {
+                    if (operand->alternatives.empty()) {
+                        result.alternatives.push_back(operand->rpn);
+                    } else {
+                        result.alternatives.insert(result.alternatives.end(),
+                                                   operand->alternatives.begin(), operand->alternatives.end());
+                    }
+                }
+                std::sort(result.alternatives.begin(), result.alternatives.end());
+                result.alternatives.erase(std::unique(result.alternatives.begin(), result.alternatives.end()),
+                                          result.alternatives.end());
+
+                result.rpn = result.alternatives[0];
+                for (ulong i = 1; i < result.alternatives.size(); ++i) {
+                    result.rpn += result.alternatives[i] + '+';
+                }
+                if (result.alternatives.size() == 1) {
+                    result.alternatives.clear();
+                }
+            }
+            terms.push(result);
+        } else if (character == '*') {
+            if (terms.empty()) {
+                throw ParseException("Missing operands");
+            }
+            Term operand = terms.top();
+            terms.pop();
+            if (operand.rpn != string(1, EPSILON) && operand.rpn.back() != '*') {
+                operand.rpn += '*';
+            }
+            operand.alternatives.clear();
+            terms.push(operand);
+        } else if (character == EPSILON || PositionAutomaton::letterIndex(character) < ALPHABET_SIZE) {
+            terms.push(Term{string(1, character), std::vector<string>()});
+        } else {
+            string message = "Unknown symbol in expression: " + string(1, character);
+            throw ParseException(message);
+        }
+    }
+
+    if (terms.size() > 1) {
+        throw ParseException("Too much operands");
+    }
+    if (terms.size() < 1) {
+        throw ParseException("Missing operands");
+    }
+    return terms.top().rpn;
+}
+
+// Заголовок файла скомпилированного выражения. Файл состоит из заголовка и таблиц
+// AutomatonView, выровненных на 8 байт; смещения отсчитываются от начала файла.
+// Загрузка -- отображение файла в память и проверка заголовка, без разбора выражения
+struct ArtifactHeader {
+    char magic[8];
+    ulong byteOrder;          // ARTIFACT_BYTE_ORDER в порядке байт записавшей машины
+    ulong version;
+    ulong alphabetSize;
+    char alphabet[8];         // буквы алфавита по порядку индексов
+    ulong positionCount;
+    ulong transitionCount;
+    ulong expressionOffset;   // каноническая запись выражения
+    ulong expressionLength;
+    ulong lettersOffset;
+    ulong transitionOffsetsOffset;
+    ulong transitionTargetsOffset;
+    ulong letterOffsetsOffset;
+    ulong positionsByLetterOffset;
+    ulong fileSize;
+};
+
+const char ARTIFACT_MAGIC[8] = {'F', 'L', 'A', 'R', 'T', 'F', 'C', 'T'};
+const ulong ARTIFACT_BYTE_ORDER = 0x0102030405060708UL;
+const ulong ARTIFACT_VERSION = 1;
+
+// Скомпилированное выражение: проверенная запись и автомат подслов её языка.
+// Компилируется один раз и затем отвечает на запросы для любого числа слов.
+// Таблицы автомата лежат либо в собственном PositionAutomaton, либо в отображённом
+// в память файле, записанном save
+struct CompiledExpression {
+private:
+    std::shared_ptr<const string> ownedExpression;
+    std::shared_ptr<const PositionAutomaton> ownedAutomaton;
+    std::shared_ptr<const MappedRegion> mapping;
+
+    string_view expression;
+    AutomatonView automaton;
+
+    CompiledExpression() {}
+
+    static ulong alignedSize(ulong size) {
+        return (size + 7) / 8 * 8;
+    }
+
+    static void checkArtifact(bool condition, const string &path) {
+        if (!condition) {
+            throw ParseException("Invalid compiled expression file: " + path);
+        }
+    }
+
+    // Проверяет, что массив из count элементов размера elementSize по смещению offset
+    // целиком лежит в файле и выровнен
+    static void checkArray(const ArtifactHeader &header, ulong offset, ulong count, ulong elementSize,
+                           const string &path) {
+        checkArtifact(offset % 8 == 0 && offset <= header.fileSize
+                      && count <= (header.fileSize - offset) / elementSize, path);
+    }
+
+    // Смещения offsets[0], ..., offsets[count] не убывают от 0 до total
+    static bool isMonotone(const ulong *offsets, ulong count, ulong total) {
+        if (offsets[0] != 0 || offsets[count] != total) {
+            return false;
+        }
+        for (ulong i = 0; i < count; ++i) {
+            if (offsets[i] > offsets[i + 1]) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Все count значений меньше bound
+    static bool isBelow(const ulong *values, ulong count, ulong bound) {
+        for (ulong i = 0; i < count; ++i) {
+            if (values[i] >= bound) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+public:
+    explicit CompiledExpression(string_view expressionText) :
+            ownedExpression(std::make_shared<const string>(expressionText)),
+            ownedAutomaton(std::make_shared<const PositionAutomaton>(expressionText)),
+            expression(*ownedExpression), automaton(ownedAutomaton->view()) {}
+
+    string_view getExpression() const {
+        return expression;
+    }
+
+    const AutomatonView &getAutomaton() const {
+        return automaton;
+    }
+
+    ulong byteSize() const {
+        if (mapping) {
+            return sizeof(CompiledExpression) + mapping->getSize();
+        }
+        return sizeof(CompiledExpression) + ownedExpression->capacity() + ownedAutomaton->byteSize();
+    }
+
+    ulong longestFactor(string_view word) const {
+        validateWord(word);
+        return longestFactorOfValidWord(word);
+    }
+
+    // То же без проверки слова: вызывающий уже проверил его validateWord
+    ulong longestFactorOfValidWord(string_view word) const {
+        FactorTracker tracker(automaton, 0);
+        tracker.advance(word.data(), word.length());
+        return tracker.longestFactor();
+    }
+
+    // Записывает выражение в файл path; файл заменяется атомарно
+    void save(const string &path) const {
+        ulong tableCount = automaton.positionCount * ALPHABET_SIZE + 1;
+
+        ArtifactHeader header;
+        std::memset(&header, 0, sizeof(header));
+        std::memcpy(header.magic, ARTIFACT_MAGIC, sizeof(header.magic));
+        header.byteOrder = ARTIFACT_BYTE_ORDER;
+        header.version = ARTIFACT_VERSION;
+        header.alphabetSize = ALPHABET_SIZE;
+        for (ulong letter = 0; letter < ALPHABET_SIZE; ++letter) {
+            header.alphabet[letter] = static_cast<char>('a' + letter);
+        }
+        header.positionCount = automaton.positionCount;
+        header.transitionCount = automaton.transitionCount();
+
+        header.expressionOffset = alignedSize(sizeof(ArtifactHeader));
+        header.expressionLength = expression.length();
+        header.lettersOffset = alignedSize(header.expressionOffset + expression.length());
+        header.transitionOffsetsOffset = alignedSize(header.lettersOffset + automaton.positionCount);
+        header.transitionTargetsOffset = header.transitionOffsetsOffset + tableCount * sizeof(ulong);
+        header.letterOffsetsOffset = header.transitionTargetsOffset + header.transitionCount * sizeof(ulong);
+        header.positionsByLetterOffset = header.letterOffsetsOffset + (ALPHABET_SIZE + 1) * sizeof(ulong);
+        header.fileSize = header.positionsByLetterOffset + automaton.positionCount * sizeof(ulong);
+
+        string image(header.fileSize, '\0');
+        std::memcpy(&image[0], &header, sizeof(header));
+        std::memcpy(&image[header.expressionOffset], expression.data(), expression.length());
+        std::memcpy(&image[header.lettersOffset], automaton.letters, automaton.positionCount);
+        std::memcpy(&image[header.transitionOffsetsOffset], automaton.transitionOffsets, tableCount * sizeof(ulong));
+        std::memcpy(&image[header.transitionTargetsOffset], automaton.transitionTargets,
+                    header.transitionCount * sizeof(ulong));
+        std::memcpy(&image[header.letterOffsetsOffset], automaton.letterOffsets, (ALPHABET_SIZE + 1) * sizeof(ulong));
+        std::memcpy(&image[header.positionsByLetterOffset], automaton.positionsByLetter,
+                    automaton.positionCount * sizeof(ulong));
+
+        string temporaryPath;
+        int fd = createTemporaryFile(path, temporaryPath);
+        if (fd < 0) {
+            throw ParseException("Cannot create " + temporaryPath + ": " + std::strerror(errno));
+        }
+        bool written = writeAll(fd, image);
+        close(fd);
+        if (!written || rename(temporaryPath.c_str(), path.c_str()) != 0) {
+            unlink(temporaryPath.c_str());
+            throw ParseException("Cannot write " + path + ": " + std::strerror(errno));
+        }
+    }
+
+    // Загружает выражение, записанное save: файл отображается в память, выражение не
+    // разбирается. Проверяются заголовок, границы таблиц и их значения: смещения не убывают,
+    // позиции меньше числа позиций, буквы из алфавита, иначе автомат читал бы и писал
+    // (FactorTracker::advance) за пределами своих массивов
+    static CompiledExpression load(const string &path) {
+        CompiledExpression result;
+        result.mapping = std::make_shared<const MappedRegion>(path);
+
+        const char *data = result.mapping->getData();
+        ulong size = result.mapping->getSize();
+        checkArtifact(size >= sizeof(ArtifactHeader), path);
+
+        const ArtifactHeader &header = *reinterpret_cast<const ArtifactHeader *>(data);
+        checkArtifact(std::memcmp(header.magic, ARTIFACT_MAGIC, sizeof(header.magic)) == 0
+                      && header.byteOrder == ARTIFACT_BYTE_ORDER && header.version == ARTIFACT_VERSION
+                      && header.alphabetSize == ALPHABET_SIZE && std::memcmp(header.alphabet, "abc", 3) == 0
+                      && header.fileSize == size
+                      && header.positionCount <= (size - 1) / sizeof(ulong) / ALPHABET_SIZE, path);
+
+        checkArray(header, header.lettersOffset, header.positionCount, 1, path);
+        checkArtifact(header.expressionOffset <= size && header.expressionLength <= size - header.expressionOffset,
+                      path);
+        checkArray(header, header.transitionOffsetsOffset, header.positionCount * ALPHABET_SIZE + 1,
+                   sizeof(ulong), path);
+        checkArray(header, header.transitionTargetsOffset, header.transitionCount, sizeof(ulong), path);
+        checkArray(header, header.letterOffsetsOffset, ALPHABET_SIZE + 1, sizeof(ulong), path);
+        checkArray(header, header.positionsByLetterOffset, header.positionCount, sizeof(ulong), path);
+
+        result.expression = string_view(data + header.expressionOffset, header.expressionLength);
+        result.automaton = AutomatonView{
+                header.positionCount,
+                data + header.lettersOffset,
+                reinterpret_cast<const ulong *>(data + header.transitionOffsetsOffset),
+                reinterpret_cast<const ulong *>(data + header.transitionTargetsOffset),
+                reinterpret_cast<const ulong *>(data + header.letterOffsetsOffset),
+                reinterpret_cast<const ulong *>(data + header.positionsByLetterOffset)};
+
+        const AutomatonView &automaton = result.automaton;
+        checkArtifact(isMonotone(automaton.transitionOffsets, header.positionCount * ALPHABET_SIZE,
+                                 header.transitionCount)
+                      && isMonotone(automaton.letterOffsets, ALPHABET_SIZE, header.positionCount)
+                      && isBelow(automaton.transitionTargets, header.transitionCount, header.positionCount)
+                      && isBelow(automaton.positionsByLetter, header.positionCount, header.positionCount), path);
+        for (ulong position = 0; position < header.positionCount; ++position) {
+            checkArtifact(PositionAutomaton::letterIndex(automaton.letters[position]) < ALPHABET_SIZE, path);
+        }
+        return result;
+    }
+};
+
+#endif // FORMAL_LANGUAGE_AUTOMATON_H
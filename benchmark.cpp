@@ -0,0 +1,79 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "formal_language.h"
+
+// Замер производительности через публичный интерфейс библиотеки:
+// benchmark [EXPRESSION] [--words N] [--length L] [--threads T]
+// Печатает время компиляции выражения и пропускную способность evaluate и evaluateBatch
+// на случайных словах
+
+namespace {
+
+double secondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    std::string expression = "aab.a.*.aab.+*.ba.1+.";
+    unsigned long wordCount = 100000;
+    unsigned long wordLength = 64;
+    unsigned long threadCount = 1;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string argument = argv[i];
+        if (argument == "--words" && i + 1 < argc) {
+            wordCount = std::strtoul(argv[++i], nullptr, 10);
+        } else if (argument == "--length" && i + 1 < argc) {
+            wordLength = std::strtoul(argv[++i], nullptr, 10);
+        } else if (argument == "--threads" && i + 1 < argc) {
+            threadCount = std::strtoul(argv[++i], nullptr, 10);
+        } else {
+            expression = argument;
+        }
+    }
+
+    std::mt19937 generator(12345);
+    std::vector<std::string> words(wordCount, std::string(wordLength, 'a'));
+    for (std::string &word : words) {
+        for (char &character : word) {
+            character = static_cast<char>('a' + generator() % 3);
+        }
+    }
+    std::vector<std::string_view> views(words.begin(), words.end());
+
+    try {
+        auto start = std::chrono::steady_clock::now();
+        formal_language::CompiledRegex regex = formal_language::CompiledRegex::compile(expression);
+        double compileSeconds = secondsSince(start);
+
+        start = std::chrono::steady_clock::now();
+        unsigned long checksum = 0;
+        for (std::string_view word : views) {
+            checksum += regex.evaluate(word);
+        }
+        double evaluateSeconds = secondsSince(start);
+
+        start = std::chrono::steady_clock::now();
+        std::vector<unsigned long> answers = regex.evaluateBatch(views, threadCount);
+        double batchSeconds = secondsSince(start);
+
+        std::cout << "expression " << regex.expression() << "\n"
+                  << "compile_us " << compileSeconds * 1e6 << "\n"
+                  << "evaluate_ns_per_word " << evaluateSeconds * 1e9 / std::max(wordCount, 1UL) << "\n"
+                  << "batch_ns_per_word " << batchSeconds * 1e9 / std::max(wordCount, 1UL) << "\n"
+                  << "checksum " << checksum << std::endl;
+    } catch (const formal_language::Error &e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,276 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "operand.h"
+#include "automaton.h"
+#include "planner.h"
+#include "tuning.h"
+#include "workload.h"
+
+// Подбор параметров движков под машину: запросы из примеров README, случайные выражения
+// разного размера и глубины звёздочек и тяжёлые формы решаются каждым движком на коротких
+// словах. Порог плотности таблиц Operand выбирается тот, при котором эти запросы решаются
+// быстрее всего; затем для каждого движка берётся медиана отношения времени запроса к оценке
+// QueryPlan. Операции Operand на подсловах до 256 символов (FixedOperand) и длиннее стоят
+// отдельно: первые снимаются с Solver на коротких словах, вторые -- с одного вычисления
+// Expression на слове длиннее 256, отдельно для списков подслов и плотных таблиц. finite_language_limit не подбирается: это предел памяти
+// индекса, а не цена операции, и в файл пишется значение по умолчанию. Результат записывается
+// в файл параметров, который загружает solution:
+// calibrate [--output FILE] [--seed S] [--sample-time SECONDS]
+
+namespace {
+
+template <typename Query>
+double timeRepeated(Query query, double minSeconds) {
+    ulong iterations = 0;
+    auto start = std::chrono::steady_clock::now();
+    double elapsed = 0;
+    while (iterations == 0 || elapsed < minSeconds) {
+        query();
+        ++iterations;
+        elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+    return elapsed / iterations;
+}
+
+double timeOperand(const string &expression, const string &word, double minSeconds) {
+    return timeRepeated([&] {
+        Solver solver(Expression(expression), word);
+        solver.solve();
+    }, minSeconds);
+}
+
+// Одно вычисление выражения операндами Operand, без перебора подслов Solver
+double timeExpression(const string &expression, const string &word, double minSeconds) {
+    return timeRepeated([&] {
+        Expression(expression).calculateValueOfExpression(word);
+    }, minSeconds);
+}
+
+double timeAutomaton(const string &expression, const string &word, double minSeconds) {
+    return timeRepeated([&] {
+        CompiledExpression compiled(expression);
+        compiled.longestFactor(word);
+    }, minSeconds);
+}
+
+double median(std::vector<double> values) {
+    std::sort(values.begin(), values.end());
+    return values[values.size() / 2];
+}
+
+// Наносекунды на операцию оценки QueryPlan для движка engine; длины слова растут,
+// пока один запрос быстрее maxQuerySeconds. У Operand длины не больше 256, и оценка целиком
+// приходится на FixedOperand
+double calibrateEngine(PlanEngine engine, const std::vector<string> &expressions, const std::vector<ulong> &lengths,
+                       WorkloadGenerator &generator, double sampleTime, double maxQuerySeconds) {
+    std::vector<double> ratios;
+    for (const string &expression : expressions) {
+        for (ulong length : lengths) {
+            string word = generator.word(length);
+            double seconds = engine == ENGINE_OPERAND ? timeOperand(expression, word, sampleTime)
+                                                      : timeAutomaton(expression, word, sampleTime);
+            QueryPlan plan(expression, length);
+            ratios.push_back(seconds * 1e9 / max(plan.getCost(engine), 1.0));
+            if (seconds > maxQuerySeconds) {
+                break;
+            }
+        }
+    }
+    return median(ratios);
+}
+
+// Подслово длины length какого-либо слова языка: путь по переходам автомата подслов из
+// случайной позиции; пустая строка, если за несколько попыток путь такой длины не нашёлся
+string languageFactor(const string &expression, ulong length, std::mt19937_64 &random) {
+    CompiledExpression compiled(expression);
+    const AutomatonView &automaton = compiled.getAutomaton();
+    for (ulong attempt = 0; attempt < 16 && automaton.positionCount > 0; ++attempt) {
+        ulong position = random() % automaton.positionCount;
+        string word(1, automaton.letters[position]);
+        while (word.length() < length) {
+            ulong count = automaton.transitionsEnd(position, ALPHABET_SIZE - 1) - automaton.transitionsBegin(position, 0);
+            if (count == 0) {
+                break;
+            }
+            position = automaton.transitionsBegin(position, 0)[random() % count];
+            word += automaton.letters[position];
+        }
+        if (word.length() == length) {
+            return word;
+        }
+    }
+    return "";
+}
+
+// Наносекунды на операцию оценки одного вычисления Expression на словах длин lengths (длиннее
+// ёмкости FixedOperand). Solver доходит до таких длин, только если в слове есть подслово слова
+// языка длиннее 256, поэтому слова -- подслова слов языка; выражения без них пропускаются,
+// а вычисляемые дольше maxQuerySeconds дальше не удлиняются. Без звёздочек работа Operand
+// приходится на списки подслов, и по таким выражениям (sparse) находится цена операции над
+// списком; у остальных из времени вычитается работа над списками по этой цене, и остаток
+// делится на работу над плотными таблицами
+double calibrateExpression(const std::vector<string> &expressions, const std::vector<ulong> &lengths, bool sparse,
+                           double sparseNanosecondsPerOp, std::mt19937_64 &random, double sampleTime,
+                           double maxQuerySeconds) {
+    std::vector<double> ratios;
+    for (const string &expression : expressions) {
+        QueryPlan shapePlan(expression, 0);
+        if ((shapePlan.getShape().stars == 0) != sparse) {
+            continue;
+        }
+        for (ulong length : lengths) {
+            string word = languageFactor(expression, length, random);
+            if (word.empty()) {
+                break;
+            }
+            QueryPlan plan(expression, length);
+            double sparseCost = plan.sparseOperandEvaluationCost(static_cast<double>(length));
+            double denseCost = plan.denseOperandEvaluationCost(static_cast<double>(length));
+            if (!sparse && denseCost < sparseCost) {
+                break; // при этом пороге плотности таблицы выражения остаются списками
+            }
+            double seconds = timeExpression(expression, word, sampleTime);
+            if (sparse) {
+                ratios.push_back(seconds * 1e9 / max(sparseCost, 1.0));
+            } else {
+                ratios.push_back(max(seconds * 1e9 - sparseCost * sparseNanosecondsPerOp, 0.0) / max(denseCost, 1.0));
+            }
+            if (seconds > maxQuerySeconds) {
+                break;
+            }
+        }
+    }
+    return ratios.empty() ? 0 : median(ratios);
+}
+
+// Выражения без звёздочек, слова которых длиннее 400: конкатенации случайных выражений без
+// звёздочек и пустого слова, иначе Operand не вычисляет их на подсловах длиннее 256
+std::vector<string> longExpressions(WorkloadGenerator &generator) {
+    std::vector<string> expressions;
+    for (ulong leafCount : {2UL, 4UL, 8UL}) {
+        string expression = generator.expression(leafCount, 0, "abc", 0);
+        for (ulong i = 1; i < 1200 / leafCount; ++i) {
+            expression += generator.expression(leafCount, 0, "abc", 0) + ".";
+        }
+        expressions.push_back(expression);
+    }
+    return expressions;
+}
+
+// Порог плотности таблиц Operand из candidates с наименьшим суммарным временем вычислений
+// выражений на словах длин lengths (длиннее ёмкости FixedOperand, иначе Operand не участвует);
+// вычисления дольше maxQuerySeconds при первом пороге в сумму не входят
+double calibrateSparseDensity(const std::vector<string> &expressions, const std::vector<ulong> &lengths,
+                              const std::vector<double> &candidates, WorkloadGenerator &generator,
+                              double sampleTime, double maxQuerySeconds) {
+    std::vector<std::pair<string, string> > queries;
+    for (const string &expression : expressions) {
+        for (ulong length : lengths) {
+            queries.emplace_back(expression, generator.word(length));
+        }
+    }
+
+    TuningConfig tuning = TuningConfig::current();
+    double best = candidates[0];
+    double bestSeconds = 0;
+    for (ulong i = 0; i < candidates.size(); ++i) {
+        tuning.operandSparseDensity = candidates[i];
+        TuningConfig::install(tuning);
+
+        double seconds = 0;
+        std::vector<std::pair<string, string> > kept;
+        for (const auto &query : queries) {
+            double querySeconds = timeExpression(query.first, query.second, sampleTime);
+            if (i > 0 || querySeconds <= maxQuerySeconds) {
+                seconds += querySeconds;
+                kept.push_back(query);
+            }
+        }
+        queries.swap(kept);
+
+        if (i == 0 || seconds < bestSeconds) {
+            best = candidates[i];
+            bestSeconds = seconds;
+        }
+    }
+    return best;
+}
+
+// Наименьшая длина слова, с которой план выбирает один из автоматов, а не Operand, или 0,
+// если такой нет до limit
+ulong crossover(const string &expression, const TuningConfig &tuning, ulong limit) {
+    for (ulong length = 1; length <= limit; ++length) {
+        if (QueryPlan(expression, length, tuning).getEngine() != ENGINE_OPERAND) {
+            return length;
+        }
+    }
+    return 0;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    string outputPath = "formal_language.tuning";
+    ulong seed = 2024;
+    double sampleTime = 0.01;
+
+    for (int i = 1; i < argc; ++i) {
+        string argument = argv[i];
+        if (argument == "--output" && i + 1 < argc) {
+            outputPath = argv[++i];
+        } else if (argument == "--seed" && i + 1 < argc) {
+            seed = std::strtoul(argv[++i], nullptr, 10);
+        } else if (argument == "--sample-time" && i + 1 < argc) {
+            sampleTime = std::atof(argv[++i]);
+        } else {
+            std::cerr << "Unknown argument: " << argument << endl;
+            return 1;
+        }
+    }
+
+    WorkloadGenerator generator(seed);
+    std::vector<string> expressions = WorkloadGenerator::readmeExpressions();
+    for (ulong leafCount : {4UL, 8UL, 16UL}) {
+        for (ulong starDepth = 0; starDepth <= 2; ++starDepth) {
+            expressions.push_back(generator.expression(leafCount, starDepth));
+        }
+    }
+    expressions.push_back(WorkloadGenerator::nestedStars(3));
+    expressions.push_back(WorkloadGenerator::starConcatenation(6));
+    expressions.push_back(WorkloadGenerator::nestedUnionStars(2));
+
+    try {
+        TuningConfig tuning;
+        tuning.operandSparseDensity = calibrateSparseDensity(expressions, {320}, {0.02, 0.05, 0.15, 0.3, 0.6, 1},
+                                                             generator, sampleTime, 0.05);
+        TuningConfig::install(tuning);
+        tuning.fixedOperandNanosecondsPerOp = calibrateEngine(ENGINE_OPERAND, expressions,
+                                                              {1, 2, 3, 4, 6, 8, 12, 16, 24}, generator, sampleTime,
+                                                              0.05);
+        std::mt19937_64 random(seed);
+        tuning.operandSparseNanosecondsPerOp = calibrateExpression(longExpressions(generator), {320, 400}, true, 0,
+                                                                   random, sampleTime, 0.05);
+        tuning.operandDenseNanosecondsPerOp = calibrateExpression(expressions, {320, 400}, false,
+                                                                  tuning.operandSparseNanosecondsPerOp, random,
+                                                                  sampleTime, 0.05);
+        tuning.automatonNanosecondsPerOp = calibrateEngine(ENGINE_AUTOMATON, expressions, {1, 4, 16, 64, 256, 4096},
+                                                           generator, sampleTime, 0.05);
+
+        cout << tuning.render();
+        for (const string &expression : WorkloadGenerator::readmeExpressions()) {
+            cout << "crossover " << expression << " " << crossover(expression, tuning, 1 << 12) << endl;
+        }
+        tuning.save(outputPath, "written by calibrate, seed " + std::to_string(seed));
+        return 0;
+    } catch (ParseException e) {
+        std::cerr << e.what() << endl;
+        return 1;
+    }
+}
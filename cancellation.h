@@ -0,0 +1,101 @@
+#ifndef FORMAL_LANGUAGE_CANCELLATION_H
+#define FORMAL_LANGUAGE_CANCELLATION_H
+
+// Кооперативная отмена вычисления по сроку или бюджету работы. Вычисление, запущенное
+// внутри CancellationScope, в контрольных точках (ядра конкатенации и цикл звёздочки Клини)
+// сообщает о проделанной работе; когда срок прошёл или бюджет исчерпан, контрольная точка
+// бросает DeadlineExceededException, и вызывающий возвращает лучший результат, доказанный
+// к этому моменту. Вне CancellationScope контрольные точки ничего не делают
+
+#include <chrono>
+#include <stdexcept>
+
+#include "common.h"
+
+struct DeadlineExceededException : public std::runtime_error {
+    DeadlineExceededException(const string &message) : std::runtime_error(message) {}
+};
+
+// Ограничения одного запроса: срок и бюджет работы в ячейках таблиц (0 -- без ограничения)
+struct EvaluationBudget {
+    bool hasDeadline;
+    std::chrono::steady_clock::time_point deadline;
+    ulong workLimit;
+
+    EvaluationBudget() : hasDeadline(false), workLimit(0) {}
+
+    static EvaluationBudget timeout(std::chrono::steady_clock::duration duration, ulong workLimit = 0) {
+        EvaluationBudget budget;
+        budget.hasDeadline = true;
+        budget.deadline = std::chrono::steady_clock::now() + duration;
+        budget.workLimit = workLimit;
+        return budget;
+    }
+
+    static EvaluationBudget work(ulong workLimit) {
+        EvaluationBudget budget;
+        budget.workLimit = workLimit;
+        return budget;
+    }
+
+    bool isUnlimited() const {
+        return !hasDeadline && workLimit == 0;
+    }
+};
+
+struct CancellationScope {
+private:
+    // Часы опрашиваются не чаще, чем раз в CLOCK_CHECK_WORK единиц работы
+    static const ulong CLOCK_CHECK_WORK = 1 << 12;
+
+    EvaluationBudget budget;
+    ulong work;
+    ulong workAtClockCheck;
+    CancellationScope *previous;
+
+    static CancellationScope *&active() {
+        static thread_local CancellationScope *scope = nullptr;
+        return scope;
+    }
+
+    void charge(ulong units) {
+        work += units;
+        if (budget.workLimit != 0 && work > budget.workLimit) {
+            throw DeadlineExceededException("Work budget of " + std::to_string(budget.workLimit)
+                                            + " cells is exhausted");
+        }
+        if (budget.hasDeadline && work - workAtClockCheck >= CLOCK_CHECK_WORK) {
+            workAtClockCheck = work;
+            if (std::chrono::steady_clock::now() >= budget.deadline) {
+                throw DeadlineExceededException("Deadline exceeded");
+            }
+        }
+    }
+
+public:
+    explicit CancellationScope(const EvaluationBudget &budget) :
+            budget(budget), work(0), workAtClockCheck(0), previous(active()) {
+        active() = this;
+    }
+
+    CancellationScope(const CancellationScope &) = delete;
+    CancellationScope &operator=(const CancellationScope &) = delete;
+
+    ~CancellationScope() {
+        active() = previous;
+    }
+
+    ulong getWork() const {
+        return work;
+    }
+
+    // Контрольная точка: units -- работа, проделанная с предыдущей точки
+    static void checkpoint(ulong units) {
+        CancellationScope *scope = active();
+        if (scope != nullptr) {
+            scope->charge(units);
+        }
+    }
+};
+
+#endif // FORMAL_LANGUAGE_CANCELLATION_H
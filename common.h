@@ -0,0 +1,116 @@
+#ifndef FORMAL_LANGUAGE_COMMON_H
+#define FORMAL_LANGUAGE_COMMON_H
+
+// Общие определения: алфавит, ошибки разбора, проверка слова
+
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <stdexcept>
+#include <cerrno>
+#include <cstdlib>
+#include <unistd.h>
+#include <sys/stat.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+using std::cout;
+using std::endl;
+using std::max;
+using std::string;
+using std::string_view;
+
+typedef unsigned long ulong;
+
+const char EPSILON = '1';
+
+const ulong ALPHABET_SIZE = 3; // буквы a, b, c
+
+const ulong STREAM_BLOCK_SIZE = 1 << 16; // размер блока при потоковом чтении слова
+
+struct ParseException : public std::logic_error {
+    ParseException(const string & message) : std::logic_error(message) {}
+};
+
+// Позиция первого символа слова вне алфавита {a, b, c} или длина слова, если таких нет.
+// Проверка идёт блоками по 16 байт: символ допустим, если он совпал с одной из букв
+inline ulong findInvalidWordSymbol(string_view word) {
+    ulong position = 0;
+
+#ifdef __SSE2__
+    const __m128i letterA = _mm_set1_epi8('a');
+    const __m128i letterB = _mm_set1_epi8('b');
+    const __m128i letterC = _mm_set1_epi8('c');
+
+    for (; position + 16 <= word.length(); position += 16) {
+        __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i *>(word.data() + position));
+        __m128i valid = _mm_or_si128(_mm_cmpeq_epi8(block, letterA),
+                                     _mm_or_si128(_mm_cmpeq_epi8(block, letterB), _mm_cmpeq_epi8(block, letterC)));
+        int mask = _mm_movemask_epi8(valid);
+        if (mask != 0xFFFF) {
+            return position + __builtin_ctz(~mask & 0xFFFF);
+        }
+    }
+#endif
+
+    for (; position < word.length(); ++position) {
+        if (word[position] < 'a' || word[position] > 'c') {
+            return position;
+        }
+    }
+    return word.length();
+}
+
+// Слово должно быть непустым и состоять только из букв a, b, c
+inline void validateWord(string_view word) {
+    if (word.empty()) {
+        throw ParseException("Word is empty");
+    }
+    ulong invalidPosition = findInvalidWordSymbol(word);
+    if (invalidPosition != word.length()) {
+        string message = "Unknown symbol in word: " + string(1, word[invalidPosition]);
+        throw ParseException(message);
+    }
+}
+
+inline bool writeAll(int fd, const string &data) {
+    ulong written = 0;
+    while (written < data.length()) {
+        ssize_t result = write(fd, data.data() + written, data.length() - written);
+        if (result < 0 && errno == EINTR) {
+            continue;
+        }
+        if (result <= 0) {
+            return false;
+        }
+        written += static_cast<ulong>(result);
+    }
+    return true;
+}
+
+// Создаёт рядом с path временный файл с уникальным именем (mkstemp) и правами 0644 и записывает
+// имя в temporaryPath; -1 при ошибке. Файл затем переименовывается на место path, поэтому
+// потоки и процессы, одновременно пишущие один path, не пишут в один временный файл
+inline int createTemporaryFile(const string &path, string &temporaryPath) {
+    temporaryPath = path + ".XXXXXX";
+    int fd = mkstemp(&temporaryPath[0]);
+    if (fd >= 0 && fchmod(fd, 0644) != 0) {
+        close(fd);
+        unlink(temporaryPath.c_str());
+        return -1;
+    }
+    return fd;
+}
+
+// 64-битный хеш FNV-1a
+inline ulong fnv1aHash(string_view data) {
+    ulong hash = 0xcbf29ce484222325UL;
+    for (char character : data) {
+        hash ^= static_cast<unsigned char>(character);
+        hash *= 0x100000001b3UL;
+    }
+    return hash;
+}
+
+#endif // FORMAL_LANGUAGE_COMMON_H
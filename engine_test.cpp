@@ -0,0 +1,603 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "operand.h"
+#include "automaton.h"
+#include "finite.h"
+#include "formal_language.h"
+#include "planner.h"
+#include "tuning.h"
+#include "weighted_operand.h"
+#include "workload.h"
+
+// Дифференциальные проверки движков: ответы исходного алгоритма сравниваются с автоматом
+// позиций CompiledExpression на случайных выражениях из WorkloadGenerator и на словах, которые
+// являются подсловами слов языка (случайный путь по автомату подслов) или почти являются
+// (в таком пути заменён один символ). Каждый раздел -- отдельный тест ctest:
+// engine_test SECTION [--seed S]; код возврата 1, если найдено расхождение
+
+namespace {
+
+ulong failures = 0;
+
+void check(bool condition, const string &description) {
+    if (condition) {
+        return;
+    }
+    ++failures;
+    if (failures <= 20) {
+        std::cerr << "mismatch: " << description << endl;
+    }
+}
+
+string describe(string_view expression, string_view word) {
+    return "expression " + string(expression) + ", word " + string(word);
+}
+
+// Случайное подслово какого-либо слова языка длины не больше length: путь по переходам автомата
+// подслов из случайной позиции. С вероятностью 1/2 в нём заменяется один символ
+string factorWord(const AutomatonView &automaton, ulong length, std::mt19937_64 &generator) {
+    string word;
+    if (automaton.positionCount == 0) {
+        return word;
+    }
+    ulong position = generator() % automaton.positionCount;
+    word += automaton.letters[position];
+    while (word.length() < length) {
+        ulong count = automaton.transitionsEnd(position, ALPHABET_SIZE - 1) - automaton.transitionsBegin(position, 0);
+        if (count == 0) {
+            break;
+        }
+        position = automaton.transitionsBegin(position, 0)[generator() % count];
+        word += automaton.letters[position];
+    }
+    if (generator() % 2 == 0) {
+        word[generator() % word.length()] = static_cast<char>('a' + generator() % ALPHABET_SIZE);
+    }
+    return word;
+}
+
+// То же выражение, в котором каждая буква x записана как x1.: язык не меняется, но литералов
+// (literal.h) в записи нет, и все подвыражения вычисляются общими ядрами Operand
+string withoutLiterals(string_view expression) {
+    string result;
+    for (char character : expression) {
+        result += character;
+        if (character >= 'a' && character <= 'c') {
+            result += "1.";
+        }
+    }
+    return result;
+}
+
+// Ответ автомата: является ли всё слово подсловом слова языка
+bool isFactor(const CompiledExpression &compiled, string_view word) {
+    return compiled.longestFactor(word) == word.length();
+}
+
+// Случайные выражения с не больше чем maxLeaves листьями и вложенностью звёздочек до 2
+template <typename Query>
+void forRandomExpressions(ulong seed, ulong count, ulong maxLeaves, Query query) {
+    WorkloadGenerator generator(seed);
+    for (ulong i = 0; i < count; ++i) {
+        string expression = generator.expression(1 + i % maxLeaves, i % 3, "abc", 0.1);
+        query(expression);
+    }
+}
+
+// Представления таблиц Operand: порог плотности 0 держит таблицы плотными, очень большой --
+// списками, значение по умолчанию переключает их по ходу вычисления. Для каждого порога
+// ответ Solver и значение Expression на словах, вычисляемое только операндами Operand
+// (без FixedOperand), сравниваются с автоматом
+void checkRepresentations(ulong seed) {
+    std::mt19937_64 generator(seed);
+    for (double density : {0.0, TuningConfig().operandSparseDensity, 1e9}) {
+        TuningConfig tuning;
+        tuning.operandSparseDensity = density;
+        TuningConfig::install(tuning);
+
+        forRandomExpressions(seed, 1000, 8, [&](const string &randomExpression) {
+            CompiledExpression compiled(randomExpression);
+            for (const string &expression : {randomExpression, withoutLiterals(randomExpression)}) {
+                for (ulong length : {1UL, 2UL, 3UL, 5UL, 8UL, 12UL, 18UL}) {
+                    string word = factorWord(compiled.getAutomaton(), length, generator);
+                    if (word.empty()) {
+                        continue; // в выражении нет букв
+                    }
+                    string description = describe(expression, word) + ", density " + std::to_string(density);
+                    check(Solver(Expression(expression), word).solve() == compiled.longestFactor(word),
+                          "Solver, " + description);
+                    Expression evaluated(expression);
+                    check(evaluated.calculateValueOfExpression(word).isWordEqualToSomeSubstringInLanguage()
+                          == isFactor(compiled, word), "Operand, " + description);
+                }
+            }
+        });
+    }
+    TuningConfig::install(TuningConfig());
+}
+
+// Границы ёмкостей FixedOperand: подслово длины до 64, 128 и 256 Solver вычисляет операндом
+// наименьшей подходящей ёмкости, длиннее -- Operand. На словах длин N - 1, N и N + 1 у каждой
+// ёмкости N каждый подходящий FixedEvaluator сравнивается с автоматом; Solver на таких словах
+// перебирает все длины подслов до длины слова, в том числе 257 (Operand)
+void checkFixedCapacities(ulong seed) {
+    std::mt19937_64 generator(seed);
+    FixedEvaluator<64> shortEvaluator;
+    FixedEvaluator<128> mediumEvaluator;
+    FixedEvaluator<256> longEvaluator;
+    const std::vector<ulong> lengths = {63, 64, 65, 127, 128, 129, 255, 256, 257};
+
+    // Звёздочка сверху: путь по автомату подслов продолжается до любой длины
+    forRandomExpressions(seed, 24, 6, [&](const string &randomExpression) {
+        string expression = randomExpression + "*";
+        CompiledExpression compiled(expression);
+        Expression parsed(expression);
+        for (ulong length : lengths) {
+            string word = factorWord(compiled.getAutomaton(), length, generator);
+            if (word.length() != length) {
+                continue; // в выражении нет букв
+            }
+            bool expected = isFactor(compiled, word);
+            ulong starIterations = 0;
+            if (length <= 64) {
+                check(shortEvaluator.containsWordAsSubstring(expression, parsed.getLiteralSpans(), word,
+                                                             starIterations) == expected,
+                      "FixedEvaluator<64>, " + describe(expression, word));
+            }
+            if (length <= 128) {
+                check(mediumEvaluator.containsWordAsSubstring(expression, parsed.getLiteralSpans(), word,
+                                                              starIterations) == expected,
+                      "FixedEvaluator<128>, " + describe(expression, word));
+            }
+            if (length <= 256) {
+                check(longEvaluator.containsWordAsSubstring(expression, parsed.getLiteralSpans(), word,
+                                                            starIterations) == expected,
+                      "FixedEvaluator<256>, " + describe(expression, word));
+            }
+        }
+    });
+
+    // Принадлежность языку: у выражения f над буквами a, b слово cxc -- подслово слова языка cf*c
+    // ровно тогда, когда x лежит в f*, то есть ответ зависит от строк таблицы подслов f* целиком,
+    // а не только от таблиц префиксов и суффиксов
+    forRandomExpressions(seed + 1, 24, 6, [&](const string &randomExpression) {
+        string letters;
+        for (char character : randomExpression) {
+            letters += character == 'c' ? 'a' : character;
+        }
+        string expression = "c" + letters + "*.c.";
+        CompiledExpression compiled(expression);
+        CompiledExpression starred(letters + "*");
+        Expression parsed(expression);
+        for (ulong length : lengths) {
+            string word = "c" + factorWord(starred.getAutomaton(), length - 2, generator) + "c";
+            if (word.length() != length) {
+                continue;
+            }
+            bool expected = isFactor(compiled, word);
+            ulong starIterations = 0;
+            if (length <= 64) {
+                check(shortEvaluator.containsWordAsSubstring(expression, parsed.getLiteralSpans(), word,
+                                                             starIterations) == expected,
+                      "FixedEvaluator<64>, " + describe(expression, word));
+            }
+            if (length <= 128) {
+                check(mediumEvaluator.containsWordAsSubstring(expression, parsed.getLiteralSpans(), word,
+                                                              starIterations) == expected,
+                      "FixedEvaluator<128>, " + describe(expression, word));
+            }
+            if (length <= 256) {
+                check(longEvaluator.containsWordAsSubstring(expression, parsed.getLiteralSpans(), word,
+                                                            starIterations) == expected,
+                      "FixedEvaluator<256>, " + describe(expression, word));
+            }
+        }
+    });
+
+    // Слово длины 257 -- подслово слова языка, поэтому Solver проверяет подслова всех длин
+    // от 1 до 257; у выражений со звёздочкой сверху такое слово есть, и Operand на длине 257
+    // вычисляется быстро
+    for (const string expression : {"ab+*", "ab.c+*", "ab.*"}) {
+        CompiledExpression compiled(expression);
+        string word;
+        while (word.length() != 257 || !isFactor(compiled, word)) {
+            word = factorWord(compiled.getAutomaton(), 257, generator);
+        }
+        check(Solver(Expression(expression), word).solve() == 257, "Solver, " + describe(expression, word));
+    }
+}
+
+// Литералы (literal.h): таблицы w и w* строятся сопоставлением строк, а не общими ядрами Operand.
+// Периодические литералы (a^k, (ab)^k) и непериодические, со звёздочкой и без, стоят в выражениях,
+// где нужны разные таблицы: подслова (cw*c над буквами a, b), префиксы и суффиксы (cw*, w*c,
+// w*cw*, в том числе целиком w рядом с операндом, содержащим пустое слово: wc*a). На словах всех длин до 20, в том числе не кратных |w|, ответ выражения с литералами
+// сравнивается с ответом той же записи без литералов и с автоматом
+void checkLiterals(ulong seed) {
+    std::mt19937_64 generator(seed);
+    const std::vector<string> literals = {"a", "aa", "aaaa", "aaaaa", "ab", "abab", "ababab", "aba", "abaab",
+                                          "aab", "abb", "ababb"};
+    const std::vector<string> contexts = {"L", "cL.", "Lc.", "cL.c.", "Lc.L.", "LL.", "La+", "cL.*",
+                                          "Lc*.a.", "ac*L..", "Lc*.L."};
+    FixedEvaluator<64> shortEvaluator;
+
+    for (const string &literal : literals) {
+        string notation(1, literal[0]);
+        for (ulong i = 1; i < literal.length(); ++i) {
+            notation += string(1, literal[i]) + ".";
+        }
+        for (const string &operand : {notation, notation + "*"}) {
+            for (const string &context : contexts) {
+                string expression;
+                for (char character : context) {
+                    expression += character == 'L' ? operand : string(1, character);
+                }
+                CompiledExpression compiled(expression);
+                Expression parsed(expression);
+                string general = withoutLiterals(expression);
+                for (ulong length = 1; length <= 20; ++length) {
+                    string word = factorWord(compiled.getAutomaton(), length, generator);
+                    if (word.length() != length) {
+                        continue; // язык конечен, и подслов такой длины нет
+                    }
+                    string description = describe(expression, word);
+                    bool expected = isFactor(compiled, word);
+                    Expression evaluated(expression);
+                    check(evaluated.calculateValueOfExpression(word).isWordEqualToSomeSubstringInLanguage()
+                          == expected, "Operand, " + description);
+                    Expression generalEvaluated(general);
+                    check(generalEvaluated.calculateValueOfExpression(word).isWordEqualToSomeSubstringInLanguage()
+                          == expected, "Operand without literals, " + description);
+                    ulong starIterations = 0;
+                    check(shortEvaluator.containsWordAsSubstring(expression, parsed.getLiteralSpans(), word,
+                                                                 starIterations) == expected,
+                          "FixedEvaluator<64>, " + description);
+                    check(Solver(Expression(expression), word).solve() == compiled.longestFactor(word),
+                          "Solver, " + description);
+                }
+            }
+        }
+    }
+}
+
+// Конечные языки (finite.h): ответ обобщённого суффиксного автомата сравнивается с автоматом
+// позиций. У языков из слов с общими суффиксами (abc, bbc, cc) при добавлении слова переход уже
+// ведёт в более длинное состояние, и оно расщепляется (cloneState). Язык ровно
+// из finite_language_limit букв индексируется, на букву больше -- нет, и планировщик выбирает
+// другой движок
+void checkFinite(ulong seed) {
+    std::mt19937_64 generator(seed);
+    WorkloadGenerator workload(seed);
+    auto compare = [&](const string &expression, const FiniteLanguageIndex &index) {
+        CompiledExpression compiled(expression);
+        for (ulong length : {1UL, 2UL, 3UL, 5UL, 8UL, 12UL}) {
+            string word = length < 5 ? workload.word(length) : factorWord(compiled.getAutomaton(), length, generator);
+            if (word.empty()) {
+                continue;
+            }
+            word += workload.word(length % 3); // подслово языка внутри слова
+            check(index.longestFactor(word) == compiled.longestFactor(word), "FiniteLanguageIndex, "
+                  + describe(expression, word));
+        }
+    };
+
+    const std::vector<string> sharedSuffixes = {"ab.c.bb.c.+cc.+", "ab.b.b+ba.b.+", "aa.b.ba.b.+cb.+ab.c.+",
+                                                "ab.a.c.ba.c.+a.c+"};
+    for (const string &expression : sharedSuffixes) {
+        compare(expression, FiniteLanguageIndex(expression, TuningConfig().finiteLanguageLimit));
+    }
+
+    for (ulong i = 0; i < 500; ++i) {
+        string expression = workload.expression(1 + i % 10, 0, "abc", 0.1);
+        compare(expression, FiniteLanguageIndex(expression, TuningConfig().finiteLanguageLimit));
+    }
+
+    // abc, bbc, cc -- 8 букв; с a -- 9
+    const string atLimit = sharedSuffixes[0];
+    const string overLimit = atLimit + "a+";
+    TuningConfig tuning;
+    tuning.finiteLanguageLimit = 8;
+    check(FiniteLanguageIndex(atLimit, tuning.finiteLanguageLimit).getLetterCount() == 8,
+          "letter count, expression " + atLimit);
+    try {
+        FiniteLanguageIndex index(overLimit, tuning.finiteLanguageLimit);
+        check(false, "finite_language_limit is not enforced, expression " + overLimit);
+    } catch (ParseException e) {
+        check(string(e.what()) == "Finite language exceeds finite_language_limit",
+              "unexpected error " + string(e.what()) + ", expression " + overLimit);
+    }
+    for (ulong wordLength : {1UL, 64UL, 100000UL}) {
+        check(QueryPlan(atLimit, wordLength, tuning).isAvailable(ENGINE_FINITE), "finite engine is unavailable, expression "
+              + atLimit);
+        QueryPlan fallback(overLimit, wordLength, tuning);
+        check(!fallback.isAvailable(ENGINE_FINITE) && fallback.getEngine() != ENGINE_FINITE,
+              "finite engine is planned over the limit, expression " + overLimit);
+    }
+}
+
+// Булево полукольцо, вычисляемое общим шаблоном BasicOperand, а не специализацией Operand
+struct GenericBooleanSemiring : BooleanSemiring {};
+
+// Полукольца (semiring.h): общий шаблон BasicOperand на булевых значениях отвечает так же, как
+// Solver и автомат, а веса в остальных полукольцах на небольших выражениях равны сосчитанным
+// вручную
+void checkSemirings(ulong seed) {
+    std::mt19937_64 generator(seed);
+    forRandomExpressions(seed, 300, 6, [&](const string &expression) {
+        CompiledExpression compiled(expression);
+        for (ulong length : {1UL, 2UL, 3UL, 5UL, 8UL}) {
+            string word = factorWord(compiled.getAutomaton(), length, generator);
+            if (word.empty()) {
+                continue;
+            }
+            string description = describe(expression, word);
+            BasicExpression<GenericBooleanSemiring> evaluated(expression);
+            check(evaluated.calculateValueOfExpression(word).isWordEqualToSomeSubstringInLanguage()
+                  == isFactor(compiled, word), "BasicOperand<boolean>, " + description);
+
+            ulong answer = Solver(Expression(expression), word).solve();
+            WeightedSolver<GenericBooleanSemiring> weighted(expression, word);
+            check(weighted.weighFactors(answer) == GenericBooleanSemiring::one(), "WeightedSolver<boolean>, "
+                  + description);
+            check(answer == word.length() || weighted.weighFactors(answer + 1) == GenericBooleanSemiring::zero(),
+                  "WeightedSolver<boolean> past the answer, " + description);
+        }
+    });
+
+    // a*a* на aaa: aaa = a^i a^(3 - i), i = 0..3; (a*)* на aaaa: разбиения на непустые итерации a*
+    check(WeightedSolver<CountingSemiring>("a*a*.", "aaa").weighFactors(3) == 4, "count, a*a*. on aaa");
+    check(WeightedSolver<CountingSemiring>("a**", "aaaa").weighFactors(4) == 8, "count, a** on aaaa");
+    check(WeightedSolver<CountingSemiring>("ab+*", "abab").weighFactors(4) == 1, "count, ab+* on abab");
+    check(WeightedSolver<CountingSemiring>("a1+*", "aa").weighFactors(2) == 1, "count, a1+* on aa");
+    // Совпадение по середине ab.* начинается суффиксом и заканчивается префиксом итерации
+    check(WeightedSolver<CountingSemiring>("ab.*", "ba").weighFactors(2) == 1, "count, ab.* on ba");
+    check(WeightedSolver<MinCostSemiring>("ab+*", "abab", {1, 5}).weighFactors(4) == 12, "min-cost, ab+* on abab");
+    check(WeightedSolver<MinCostSemiring>("ab+a+*", "aba", {1, 5, 2}).weighFactors(3) == 7, "min-cost, ab+a+* on aba");
+    check(WeightedSolver<MaxCostSemiring>("ab+a+*", "aba", {1, 5, 2}).weighFactors(3) == 9, "max-cost, ab+a+* on aba");
+}
+
+// Каноническая запись (canonicalizeExpression): одинаковые по построению выражения получают
+// одну запись, запись канонической записи не меняется, и язык у неё тот же
+void checkCanonicalForms(ulong seed) {
+    const std::vector<std::pair<string, string> > equal = {
+            {"1ab+.c+", "ab+c+"}, {"1cb+.a+", "ab+c+"}, {"cb+1.a+", "abc++"}, {"a1cb+.+", "cba++"},
+            {"a1b+.", "ab1+."}, {"1a.*", "a**"}, {"1*a.", "a"}, {"ab+1.*c+", "cab+*+"},
+    };
+    for (const auto &pair : equal) {
+        check(canonicalizeExpression(pair.first) == canonicalizeExpression(pair.second),
+              "canonical forms of " + pair.first + " and " + pair.second + " differ: "
+              + canonicalizeExpression(pair.first) + " and " + canonicalizeExpression(pair.second));
+    }
+
+    std::mt19937_64 generator(seed);
+    forRandomExpressions(seed, 1000, 8, [&](const string &expression) {
+        string canonical = canonicalizeExpression(expression);
+        check(canonicalizeExpression(canonical) == canonical, "canonical form " + canonical + " of " + expression
+              + " is not canonical");
+        CompiledExpression compiled(expression);
+        CompiledExpression canonicalCompiled(canonical);
+        for (ulong length : {1UL, 3UL, 8UL}) {
+            string word = factorWord(compiled.getAutomaton(), length, generator) + "abc";
+            check(canonicalCompiled.longestFactor(word) == compiled.longestFactor(word),
+                  "canonical form " + canonical + ", " + describe(expression, word));
+        }
+    });
+}
+
+// Файл скомпилированного выражения (CompiledExpression::save и load): записанный файл
+// загружается и отвечает так же, а файл с испорченной таблицей отвергается при загрузке
+void checkArtifacts(ulong seed) {
+    const string path = "engine_test_" + std::to_string(getpid()) + ".flc";
+    const string expression = "ab.c+*ba.+";
+    CompiledExpression compiled(expression);
+    compiled.save(path);
+    std::ifstream input(path, std::ios::binary);
+    const string image((std::istreambuf_iterator<char>(input)), std::istreambuf_iterator<char>());
+    input.close();
+    ArtifactHeader header;
+    std::memcpy(&header, image.data(), sizeof(header));
+
+    string word = WorkloadGenerator(seed).word(64);
+    check(CompiledExpression::load(path).longestFactor(word) == compiled.longestFactor(word),
+          "loaded artifact, " + describe(expression, word));
+
+    auto setUlong = [](string &corrupted, ulong offset, ulong value) {
+        std::memcpy(&corrupted[offset], &value, sizeof(value));
+    };
+    const ulong last = header.positionCount * ALPHABET_SIZE;
+    const std::vector<std::pair<string, std::function<void(string &)> > > corruptions = {
+            {"transition target", [&](string &corrupted) {
+                setUlong(corrupted, header.transitionTargetsOffset, header.positionCount);
+            }},
+            {"position by letter", [&](string &corrupted) {
+                setUlong(corrupted, header.positionsByLetterOffset + sizeof(ulong), ~0UL);
+            }},
+            {"letter", [&](string &corrupted) {
+                corrupted[header.lettersOffset + 1] = 'd';
+            }},
+            {"transition offset order", [&](string &corrupted) {
+                setUlong(corrupted, header.transitionOffsetsOffset + sizeof(ulong), header.transitionCount + 1);
+            }},
+            {"first transition offset", [&](string &corrupted) {
+                setUlong(corrupted, header.transitionOffsetsOffset, 1);
+            }},
+            {"last transition offset", [&](string &corrupted) {
+                setUlong(corrupted, header.transitionOffsetsOffset + last * sizeof(ulong), header.transitionCount - 1);
+            }},
+            {"letter offset order", [&](string &corrupted) {
+                setUlong(corrupted, header.letterOffsetsOffset + sizeof(ulong), header.positionCount + 1);
+            }},
+    };
+    for (const auto &corruption : corruptions) {
+        string corrupted = image;
+        corruption.second(corrupted);
+        std::ofstream(path, std::ios::binary | std::ios::trunc) << corrupted;
+        try {
+            CompiledExpression::load(path);
+            check(false, "artifact is loaded despite a corrupted " + corruption.first);
+        } catch (ParseException e) {
+            check(string(e.what()) == "Invalid compiled expression file: " + path,
+                  "unexpected error " + string(e.what()) + " for a corrupted " + corruption.first);
+        }
+    }
+    std::remove(path.c_str());
+}
+
+// Библиотека (formal_language.h): каждый движок за CompiledRegex, выбранный планировщиком или
+// заданный явно, отвечает как автомат позиций, пакетный ответ в нескольких потоках -- как
+// поодиночке; бюджет работы даёт нижнюю границу с признаком partial, предел памяти --
+// MemoryLimitError, а C ABI сообщает о них кодами возврата
+void checkLibrary(ulong seed) {
+    using formal_language::CompiledRegex;
+    using formal_language::Engine;
+    using formal_language::EvaluationOptions;
+    std::mt19937_64 generator(seed);
+    forRandomExpressions(seed, 300, 8, [&](const string &expression) {
+        CompiledRegex regex = CompiledRegex::compile(expression);
+        CompiledExpression compiled(expression);
+        std::vector<Engine> engines = {Engine::Auto, Engine::Operand, Engine::Automaton};
+        if (QueryPlan(regex.expression(), 1).isAvailable(ENGINE_FINITE)) {
+            engines.push_back(Engine::Finite);
+        }
+        std::vector<string> words = {""};
+        for (ulong length : {1UL, 4UL, 9UL, 20UL}) {
+            words.push_back(factorWord(compiled.getAutomaton(), length, generator));
+        }
+        std::vector<std::string_view> views(words.begin(), words.end());
+        for (Engine engine : engines) {
+            EvaluationOptions options;
+            options.engine = engine;
+            std::vector<formal_language::Evaluation> batch = regex.evaluateBatch(views, options, 3);
+            for (ulong i = 0; i < words.size(); ++i) {
+                ulong expected = words[i].empty() ? 0 : compiled.longestFactor(words[i]);
+                formal_language::Evaluation single = regex.evaluate(words[i], options);
+                check(single.length == expected && !single.partial, "CompiledRegex engine "
+                      + std::to_string(static_cast<int>(engine)) + ", " + describe(expression, words[i]));
+                check(batch[i].length == expected && !batch[i].partial, "CompiledRegex batch, engine "
+                      + std::to_string(static_cast<int>(engine)) + ", " + describe(expression, words[i]));
+            }
+        }
+    });
+
+    const string expression = "ab+*a.b.*";
+    const string word(64, 'a');
+    CompiledRegex regex = CompiledRegex::compile(expression);
+    EvaluationOptions budgeted;
+    budgeted.engine = Engine::Operand;
+    budgeted.workBudget = 100;
+    formal_language::Evaluation partial = regex.evaluate(word, budgeted);
+    check(partial.partial && partial.length < word.length(), "work budget is not enforced, "
+          + describe(expression, word));
+
+    EvaluationOptions limited;
+    limited.engine = Engine::Operand;
+    limited.memoryLimitBytes = 100;
+    try {
+        regex.evaluate(word, limited);
+        check(false, "memory limit is not enforced, " + describe(expression, word));
+    } catch (const formal_language::MemoryLimitError &) {
+    }
+    EvaluationOptions finite;
+    finite.engine = Engine::Finite;
+    try {
+        regex.evaluate(word, finite);
+        check(false, "finite engine accepts an infinite language, expression " + expression);
+    } catch (const formal_language::Error &e) {
+        check(string(e.what()) == "Language is infinite", "unexpected error " + string(e.what()));
+    }
+
+    fl_regex *handle = fl_compile(expression.data(), expression.length(), nullptr, 0);
+    char error[128] = "";
+    int partialFlag = 0;
+    check(fl_evaluate_within(handle, word.data(), word.length(), 0, 0, &partialFlag, error, sizeof(error))
+          == static_cast<long>(word.length()) && partialFlag == 0, "fl_evaluate_within, " + describe(expression, word));
+    check(fl_evaluate_within(handle, "abd", 3, 0, 0, nullptr, error, sizeof(error)) == -1,
+          "fl_evaluate_within accepts an invalid word");
+    const char *words[] = {word.data(), "ab"};
+    const size_t lengths[] = {word.length(), 2};
+    unsigned long answers[2] = {0, 0};
+    int partialFlags[2] = {1, 1};
+    check(fl_evaluate_batch_within(handle, words, lengths, 2, 0, 0, answers, partialFlags, 2, error, sizeof(error)) == 0
+          && answers[0] == word.length() && answers[1] == 2 && partialFlags[0] == 0 && partialFlags[1] == 0,
+          "fl_evaluate_batch_within, expression " + expression);
+    fl_free(handle);
+}
+
+// Планировщик (planner.h) на словах длиннее 256, где Operand вычисляет подслова общими
+// таблицами: выражения со звёздочками, которые автомат решает за миллисекунды, не планируются
+// на Operand, одно вычисление ab+*a.b.* на слове из 300 букв (на машине разработки 0.7 с)
+// оценивается не меньше чем в 0.1 с, а у конкатенации букв нет работы над плотными таблицами
+void checkPlanner(ulong) {
+    TuningConfig tuning;
+    std::vector<string> expressions = WorkloadGenerator::readmeExpressions();
+    expressions.insert(expressions.end(), {"ab+*a.b.*", "ab+*", "ab+*c.", "a*b*.c*.", "ab.*ba.*+",
+                                           WorkloadGenerator::nestedStars(3)});
+    for (const string &expression : expressions) {
+        for (ulong wordLength : {257UL, 280UL, 400UL, 1000UL}) {
+            QueryPlan plan(expression, wordLength, tuning);
+            check(plan.getEngine() != ENGINE_OPERAND, "operand is planned for a word of length "
+                  + std::to_string(wordLength) + ", expression " + expression);
+        }
+    }
+
+    QueryPlan starPlan("ab+*a.b.*", 300, tuning);
+    check(starPlan.denseOperandEvaluationCost(300) * tuning.operandDenseNanosecondsPerOp >= 1e8,
+          "dense Operand work is underestimated, expression ab+*a.b.*");
+
+    string literal = "a";
+    for (ulong i = 1; i < 300; ++i) {
+        literal += "a.";
+    }
+    QueryPlan literalPlan(literal, 300, tuning);
+    check(literalPlan.denseOperandEvaluationCost(300) == 0
+          && literalPlan.sparseOperandEvaluationCost(300) * tuning.operandSparseNanosecondsPerOp < 1e6,
+          "sparse Operand work is overestimated, concatenation of 300 letters");
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    std::map<string, std::function<void(ulong)> > sections = {
+            {"representations", checkRepresentations},
+            {"fixed-capacities", checkFixedCapacities},
+            {"literals", checkLiterals},
+            {"finite", checkFinite},
+            {"semirings", checkSemirings},
+            {"canonical", checkCanonicalForms},
+            {"artifact", checkArtifacts},
+            {"library", checkLibrary},
+            {"planner", checkPlanner},
+    };
+
+    if (argc < 2 || sections.count(argv[1]) == 0) {
+        std::cerr << "Usage: engine_test SECTION [--seed S]; sections:";
+        for (const auto &section : sections) {
+            std::cerr << " " << section.first;
+        }
+        std::cerr << endl;
+        return 2;
+    }
+    ulong seed = 2024;
+    if (argc == 4 && string(argv[2]) == "--seed") {
+        seed = std::strtoul(argv[3], nullptr, 10);
+    }
+
+    try {
+        sections[argv[1]](seed);
+    } catch (ParseException e) {
+        std::cerr << e.what() << endl;
+        return 1;
+    }
+    if (failures > 0) {
+        std::cerr << failures << " mismatches" << endl;
+        return 1;
+    }
+    return 0;
+}
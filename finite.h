@@ -0,0 +1,209 @@
+#ifndef FORMAL_LANGUAGE_FINITE_H
+#define FORMAL_LANGUAGE_FINITE_H
+
+// Конечный язык: выражение без звёздочек (звёздочка допустима только над языком {1}) задаёт
+// конечное множество слов. Слова перечисляются, и по ним строится обобщённый суффиксный автомат:
+// он распознаёт ровно подслова слов языка. Ответ -- проход по слову с переходами по суффиксным
+// ссылкам, как в поиске наибольшей общей подстроки, за O(n) после построения
+
+#include <vector>
+#include <stack>
+#include <algorithm>
+
+#include "common.h"
+
+struct FiniteLanguageIndex {
+private:
+    static constexpr ulong NO_STATE = static_cast<ulong>(-1);
+
+    struct State {
+        ulong length; // длина самого длинного подслова, ведущего в состояние
+        ulong link;   // суффиксная ссылка; NO_STATE у корня
+        ulong next[ALPHABET_SIZE];
+    };
+
+    std::vector<State> states;
+    ulong letterCount;
+
+    static ulong totalLetters(const std::vector<string> &words) {
+        ulong letters = 0;
+        for (const string &word : words) {
+            letters += word.length();
+        }
+        return letters;
+    }
+
+    static void normalize(std::vector<string> &words) {
+        std::sort(words.begin(), words.end());
+        words.erase(std::unique(words.begin(), words.end()), words.end());
+    }
+
+    // Слова языка выражения без повторов; сумма их длин не больше limit. Ошибки записи
+    // сообщаются раньше бесконечности и размера языка, как у остальных движков
+    static std::vector<string> enumerate(string_view expression, double limit) {
+        if (expression.empty()) {
+            throw ParseException("Expression is empty");
+        }
+
+        std::stack<std::vector<string> > languages;
+        string failure; // после неё слова не перечисляются, только проверяется запись
+        auto fits = [limit, &failure](double letters) {
+            if (failure.empty() && letters > limit) {
+                failure = "Finite language exceeds finite_language_limit";
+            }
+            return failure.empty();
+        };
+
+        for (char character : expression) {
+            if (character == '+' || character == '.') {
+                if (languages.size() < 2) {
+                    throw ParseException("Missing operands");
+                }
+                std::vector<string> right = std::move(languages.top());
+                languages.pop();
+                std::vector<string> &left = languages.top();
+
+                if (character == '+') {
+                    if (fits(static_cast<double>(totalLetters(left) + totalLetters(right)))) {
+                        left.insert(left.end(), right.begin(), right.end());
+                    }
+                } else if (fits(static_cast<double>(totalLetters(left)) * static_cast<double>(right.size())
+                                + static_cast<double>(totalLetters(right)) * static_cast<double>(left.size()))) {
+                    // Каждое слово left встречается в произведении right.size() раз, и наоборот
+                    std::vector<string> product;
+                    product.reserve(left.size() * right.size());
+                    for (const string &prefix : left) {
+                        for (const string &suffix : right) {
+                            product.push_back(prefix + suffix);
+                        }
+                    }
+                    left.swap(product);
+                }
+                normalize(left);
+            } else if (character == '*') {
+                if (languages.empty()) {
+                    throw ParseException("Missing operands");
+                }
+                if (failure.empty() && totalLetters(languages.top()) != 0) {
+                    failure = "Language is infinite";
+                }
+            } else if (character == EPSILON) {
+                languages.push(std::vector<string>(1, ""));
+            } else if (character >= 'a' && character <= 'c') {
+                languages.push(std::vector<string>(1, string(1, character)));
+                fits(1);
+            } else {
+                string message = "Unknown symbol in expression: " + string(1, character);
+                throw ParseException(message);
+            }
+        }
+
+        if (languages.size() > 1) {
+            throw ParseException("Too much operands");
+        }
+        if (languages.size() < 1) {
+            throw ParseException("Missing operands");
+        }
+        if (!failure.empty()) {
+            throw ParseException(failure);
+        }
+        return languages.top();
+    }
+
+    // Копия состояния target с длиной length, на которую переводится суффиксная ссылка target
+    ulong cloneState(ulong target, ulong length) {
+        ulong clone = states.size();
+        states.push_back(states[target]);
+        states[clone].length = length;
+        states[target].link = clone;
+        return clone;
+    }
+
+    // Переходы по letter в target из last и его суффиксных ссылок переводятся в clone
+    void redirect(ulong last, ulong letter, ulong target, ulong clone) {
+        for (ulong state = last; state != NO_STATE && states[state].next[letter] == target;
+             state = states[state].link) {
+            states[state].next[letter] = clone;
+        }
+    }
+
+    // Продолжение слова, прочитанного до состояния last, буквой letter; возвращает новое last.
+    // Если переход уже есть (слово -- продолжение ранее добавленного), новое состояние не
+    // заводится, а при необходимости расщепляется существующее
+    ulong extend(ulong last, ulong letter) {
+        ulong existing = states[last].next[letter];
+        if (existing != NO_STATE) {
+            if (states[existing].length == states[last].length + 1) {
+                return existing;
+            }
+            ulong clone = cloneState(existing, states[last].length + 1);
+            redirect(last, letter, existing, clone);
+            return clone;
+        }
+
+        ulong current = states.size();
+        states.push_back(State{states[last].length + 1, 0, {NO_STATE, NO_STATE, NO_STATE}});
+        ulong state = last;
+        for (; state != NO_STATE && states[state].next[letter] == NO_STATE; state = states[state].link) {
+            states[state].next[letter] = current;
+        }
+        if (state == NO_STATE) {
+            return current;
+        }
+        ulong target = states[state].next[letter];
+        if (states[target].length == states[state].length + 1) {
+            states[current].link = target;
+            return current;
+        }
+        ulong clone = cloneState(target, states[state].length + 1);
+        redirect(state, letter, target, clone);
+        states[current].link = clone;
+        return current;
+    }
+
+public:
+    // limit -- наибольшая сумма длин слов языка; больший язык -- ParseException
+    FiniteLanguageIndex(string_view expression, double limit) : letterCount(0) {
+        std::vector<string> words = enumerate(expression, limit);
+        letterCount = totalLetters(words);
+        states.reserve(2 * letterCount + 1);
+        states.push_back(State{0, NO_STATE, {NO_STATE, NO_STATE, NO_STATE}});
+        for (const string &word : words) {
+            ulong last = 0;
+            for (char character : word) {
+                last = extend(last, static_cast<ulong>(character - 'a'));
+            }
+        }
+    }
+
+    // Сумма длин слов языка
+    ulong getLetterCount() const {
+        return letterCount;
+    }
+
+    ulong getStateCount() const {
+        return states.size();
+    }
+
+    ulong longestFactor(string_view word) const {
+        validateWord(word);
+        ulong best = 0;
+        ulong state = 0;
+        ulong length = 0;
+        for (char character : word) {
+            ulong letter = static_cast<ulong>(character - 'a');
+            while (state != 0 && states[state].next[letter] == NO_STATE) {
+                state = states[state].link;
+                length = states[state].length;
+            }
+            if (states[state].next[letter] != NO_STATE) {
+                state = states[state].next[letter];
+                ++length;
+            }
+            best = std::max(best, length);
+        }
+        return best;
+    }
+};
+
+#endif // FORMAL_LANGUAGE_FINITE_H
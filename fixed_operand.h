@@ -0,0 +1,253 @@
+#ifndef FORMAL_LANGUAGE_FIXED_OPERAND_H
+#define FORMAL_LANGUAGE_FIXED_OPERAND_H
+
+// Операнды исходного алгоритма для коротких слов. Таблицы имеют ёмкость N, заданную при
+// компиляции, и лежат внутри объекта: строка таблицы подслов -- std::bitset<N>, её бит
+// length - 1 соответствует ячейке containsSubstring[start][length] у Operand, так же устроены
+// таблицы префиксов и суффиксов. Конкатенация для каждой верной ячейки левой таблицы сдвигает
+// и объединяет целую строку правой, то есть при N = 64 это несколько регистровых операций.
+// Solver выбирает наименьшую ёмкость, в которую помещается подслово, более длинные подслова
+// вычисляются операндами Operand
+
+#include <algorithm>
+#include <bitset>
+#include <vector>
+
+#include "common.h"
+#include "cancellation.h"
+#include "literal.h"
+#include "operand_memory.h"
+#include "phase_profiler.h"
+
+// Наименьший установленный бит row с номером не меньше from или N, если такого нет.
+// _Find_first и _Find_next есть только в libstdc++; в остальных библиотеках строка
+// просматривается по 64 бита
+template <ulong N>
+ulong nextSetBit(const std::bitset<N> &row, ulong from) {
+#ifdef __GLIBCXX__
+    return from == 0 ? row._Find_first() : row._Find_next(from - 1);
+#else
+    static const std::bitset<N> lowWord(~0ULL);
+    for (ulong base = from; base < N; base += 64) {
+        unsigned long long chunk = ((row >> base) & lowWord).to_ullong();
+        if (chunk != 0) {
+            return std::min(N, base + static_cast<ulong>(__builtin_ctzll(chunk)));
+        }
+    }
+    return N;
+#endif
+}
+
+template <ulong N>
+struct FixedOperand {
+    typedef std::bitset<N> Row;
+
+    Row containsSubstring[N];
+    // containsSubstring[start][length - 1] -- как containsSubstring[start][length] у Operand;
+    // используются только строки с start < wordLength
+
+    Row containsSuffixEqualsToPrefix;
+    Row containsPrefixEqualsToSuffix;
+    // бит length - 1 -- как соответствующие таблицы Operand
+
+    bool containsEpsilon;
+    bool containsWordAsSubstring;
+    ulong wordLength;
+
+    // Операнд, задающий пустой язык
+    explicit FixedOperand(ulong wordLength) :
+            containsEpsilon(false), containsWordAsSubstring(false), wordLength(wordLength) {}
+
+    // Операнд, задающий язык из одного символа
+    FixedOperand(char character, string_view word) : FixedOperand(word.length()) {
+        if (character == EPSILON) {
+            containsEpsilon = true;
+            return;
+        }
+        for (ulong startPosition = 0; startPosition < wordLength; ++startPosition) {
+            containsSubstring[startPosition][0] = word[startPosition] == character;
+        }
+        containsSuffixEqualsToPrefix[0] = word[0] == character;
+        containsPrefixEqualsToSuffix[0] = word.back() == character;
+        containsWordAsSubstring = wordLength == 1 && word[0] == character;
+    }
+
+    // Операнд литерала w или w*, таблицы которого вычислены сопоставлением строк
+    FixedOperand(const LiteralTables &tables, ulong wordLength) : FixedOperand(wordLength) {
+        for (const OperandInterval &interval : tables.substrings) {
+            containsSubstring[interval.start][interval.length - 1] = true;
+        }
+        for (ulong length : tables.suffixEqualsToPrefix) {
+            containsSuffixEqualsToPrefix[length - 1] = true;
+        }
+        for (ulong length : tables.prefixEqualsToSuffix) {
+            containsPrefixEqualsToSuffix[length - 1] = true;
+        }
+        containsEpsilon = tables.containsEpsilon;
+        containsWordAsSubstring = tables.containsWordAsSubstring;
+    }
+
+    void unite(const FixedOperand &other) {
+        for (ulong startPosition = 0; startPosition < wordLength; ++startPosition) {
+            containsSubstring[startPosition] |= other.containsSubstring[startPosition];
+        }
+        containsSuffixEqualsToPrefix |= other.containsSuffixEqualsToPrefix;
+        containsPrefixEqualsToSuffix |= other.containsPrefixEqualsToSuffix;
+        containsEpsilon |= other.containsEpsilon;
+        containsWordAsSubstring |= other.containsWordAsSubstring;
+    }
+
+    // result должен задавать пустой язык; формулы те же, что в Operand::operator*
+    static void multiply(const FixedOperand &left, const FixedOperand &right, FixedOperand &result) {
+        ulong wordLength = left.wordLength;
+        CancellationScope::checkpoint(wordLength * (wordLength + 1) / 2);
+
+        // Подслово с началом start -- верный префикс left длины prefixLength и верное подслово
+        // right, начинающееся в start + prefixLength
+        for (ulong startPosition = 0; startPosition < wordLength; ++startPosition) {
+            Row row;
+            if (left.containsEpsilon) {
+                row |= right.containsSubstring[startPosition];
+            }
+            if (right.containsEpsilon) {
+                row |= left.containsSubstring[startPosition];
+            }
+            const Row &prefixes = left.containsSubstring[startPosition];
+            for (ulong bit = nextSetBit(prefixes, 0); bit + 1 < wordLength - startPosition;
+                 bit = nextSetBit(prefixes, bit + 1)) {
+                row |= right.containsSubstring[startPosition + bit + 1] << (bit + 1);
+            }
+            result.containsSubstring[startPosition] = row;
+        }
+        result.containsEpsilon = left.containsEpsilon && right.containsEpsilon;
+
+        // Биты длин от 1 до wordLength - 1
+        Row properLengths;
+        for (ulong length = 1; length < wordLength; ++length) {
+            properLengths[length - 1] = true;
+        }
+
+        result.containsWordAsSubstring = left.containsWordAsSubstring || right.containsWordAsSubstring;
+        for (ulong prefixLength = 1; prefixLength < wordLength; ++prefixLength) {
+            if (left.containsSuffixEqualsToPrefix[prefixLength - 1]
+                && right.containsPrefixEqualsToSuffix[wordLength - prefixLength - 1]) {
+                result.containsWordAsSubstring = true;
+            }
+        }
+
+        // Префикс длины subPrefixLength, продолженный подсловом right с началом subPrefixLength
+        Row suffixes = right.containsSuffixEqualsToPrefix;
+        if (right.containsEpsilon) {
+            suffixes |= left.containsSuffixEqualsToPrefix;
+        }
+        const Row &subPrefixes = left.containsSuffixEqualsToPrefix;
+        for (ulong bit = nextSetBit(subPrefixes, 0); bit + 1 < wordLength; bit = nextSetBit(subPrefixes, bit + 1)) {
+            suffixes |= right.containsSubstring[bit + 1] << (bit + 1);
+        }
+        result.containsSuffixEqualsToPrefix = suffixes & properLengths;
+
+        // Суффикс длины suffixLength = wordLength - start: подслово left с началом start длины
+        // prefixOfSuffixLength, за которым остаётся суффикс right длины subSuffixLength. В строке
+        // reversedSuffixes бит end - 1 означает, что верен суффикс длины wordLength - end
+        Row prefixes = left.containsPrefixEqualsToSuffix;
+        if (left.containsEpsilon) {
+            prefixes |= right.containsPrefixEqualsToSuffix;
+        }
+        Row reversedSuffixes;
+        for (ulong end = 1; end < wordLength; ++end) {
+            reversedSuffixes[end - 1] = right.containsPrefixEqualsToSuffix[wordLength - end - 1];
+        }
+        for (ulong startPosition = 1; startPosition < wordLength; ++startPosition) {
+            if (((left.containsSubstring[startPosition] << startPosition) & reversedSuffixes).any()) {
+                prefixes[wordLength - startPosition - 1] = true;
+            }
+        }
+        result.containsPrefixEqualsToSuffix = prefixes & properLengths;
+    }
+};
+
+// Вычисление выражения операндами FixedOperand<N>. Стек операндов и таблицы литералов
+// переиспользуются между вычислениями, поэтому после первого подслова память не выделяется
+template <ulong N>
+struct FixedEvaluator {
+private:
+    std::vector<FixedOperand<N>, OperandAllocator<FixedOperand<N> > > operands;
+    LiteralTables literalTables;
+
+    void calculateKleeneStar(string_view word, ulong &starIterations) {
+        if (operands.empty()) {
+            throw ParseException("Missing operands");
+        }
+
+        // e* = e^0 + e^1 + e^2 ... как в Expression::calculateKleeneStar
+        FixedOperand<N> currentPow(EPSILON, word);
+        FixedOperand<N> startOperand = operands.back();
+        FixedOperand<N> &currentOperand = operands.back();
+        currentOperand = currentPow;
+
+        starIterations += 2 * word.length() + 2;
+        for (ulong i = 0; i < 2 * word.length() + 2; ++i) {
+            CancellationScope::checkpoint(1);
+            FixedOperand<N> nextPow(word.length());
+            FixedOperand<N>::multiply(currentPow, startOperand, nextPow);
+            currentOperand.unite(nextPow);
+            currentPow = nextPow;
+        }
+    }
+
+public:
+    // containsWordAsSubstring значения выражения на слове word (word.length() <= N); литералы из
+    // literalSpans вычисляются сопоставлением строк, ошибки записи -- те же, что у
+    // Expression::calculateValueOfExpression
+    bool containsWordAsSubstring(string_view expression, const LiteralSpans &literalSpans, string_view word,
+                                 ulong &starIterations) {
+        operands.clear();
+
+        LiteralSpans::const_iterator span = literalSpans.begin();
+        for (ulong i = 0; i < expression.length(); ++i) {
+            char character = expression[i];
+            if (span != literalSpans.end() && span->begin == i) {
+                ProfilePhaseScope phase(PHASE_LEAF);
+                literalTables.compute(*span, word);
+                operands.emplace_back(literalTables, word.length());
+                i = span->end - 1;
+                ++span;
+            } else if (character == '+' || character == '.') {
+                ProfilePhaseScope phase(character == '+' ? PHASE_UNION : PHASE_CONCATENATION);
+                if (operands.size() < 2) {
+                    throw ParseException("Missing operands");
+                }
+                FixedOperand<N> &left = operands[operands.size() - 2];
+                const FixedOperand<N> &right = operands.back();
+                if (character == '+') {
+                    left.unite(right);
+                } else {
+                    FixedOperand<N> product(word.length());
+                    FixedOperand<N>::multiply(left, right, product);
+                    left = product;
+                }
+                operands.pop_back();
+            } else if (character == '*') {
+                ProfilePhaseScope phase(PHASE_STAR);
+                calculateKleeneStar(word, starIterations);
+            } else if (character == EPSILON || (character >= 'a' && character <= 'c')) {
+                ProfilePhaseScope phase(PHASE_LEAF);
+                operands.emplace_back(character, word);
+            } else {
+                string message = "Unknown symbol in expression: " + string(1, character);
+                throw ParseException(message);
+            }
+        }
+
+        ProfilePhaseScope phase(PHASE_ANSWER);
+        if (operands.size() > 1) {
+            throw ParseException("Too much operands");
+        }
+        if (operands.size() < 1) {
+            throw ParseException("Missing operands");
+        }
+        return operands.back().containsWordAsSubstring;
+    }
+};
+
+#endif // FORMAL_LANGUAGE_FIXED_OPERAND_H
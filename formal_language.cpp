@@ -0,0 +1,354 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <exception>
+#include <mutex>
+#include <thread>
+
+#include "formal_language.h"
+#include "automaton.h"
+#include "finite.h"
+#include "operand.h"
+#include "planner.h"
+#include "tuning.h"
+
+namespace formal_language {
+
+namespace {
+
+// Таблицы движка, которые строятся при первом запросе, которому они нужны; затем их читают
+// без блокировки. Ошибка построения передаётся запросу, и следующий запрос строит заново
+template <typename Index>
+struct LazyIndex {
+private:
+    std::mutex mutex;
+    std::atomic<const Index *> ready;
+    std::unique_ptr<const Index> index;
+
+public:
+    LazyIndex() : ready(nullptr) {}
+
+    void preset(const Index &built) {
+        index.reset(new Index(built));
+        ready.store(index.get(), std::memory_order_release);
+    }
+
+    template <typename Build>
+    const Index &get(Build build) {
+        const Index *current = ready.load(std::memory_order_acquire);
+        if (current == nullptr) {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!index) {
+                index.reset(new Index(build()));
+                ready.store(index.get(), std::memory_order_release);
+            }
+            current = index.get();
+        }
+        return *current;
+    }
+};
+
+PlanEngine planEngine(Engine engine) {
+    switch (engine) {
+        case Engine::Operand:
+            return ENGINE_OPERAND;
+        case Engine::Finite:
+            return ENGINE_FINITE;
+        default:
+            return ENGINE_AUTOMATON;
+    }
+}
+
+} // namespace
+
+struct CompiledRegex::Implementation {
+    string canonical;
+    ExpressionShape shape;
+    Expression operandExpression; // ссылается на canonical
+    mutable LazyIndex<CompiledExpression> automaton;
+    mutable LazyIndex<FiniteLanguageIndex> finite;
+
+    explicit Implementation(const string &canonical) :
+            canonical(canonical), shape(this->canonical), operandExpression(this->canonical) {}
+
+    explicit Implementation(const CompiledExpression &compiled) : Implementation(string(compiled.getExpression())) {
+        automaton.preset(compiled);
+    }
+
+    const CompiledExpression &compiledAutomaton() const {
+        return automaton.get([this]() { return CompiledExpression(canonical); });
+    }
+
+    // Движок выбирается QueryPlan по длине слова, как в основном режиме solution. Непустое слово
+    // уже проверено validateWord, на пустое ответ 0
+    Evaluation evaluateValidWord(string_view word, const EvaluationOptions &options) const {
+        QueryPlan plan(shape, word.length());
+        if (options.engine != Engine::Auto) {
+            plan.force(planEngine(options.engine), "EvaluationOptions::engine");
+        }
+
+        if (plan.getEngine() == ENGINE_AUTOMATON) {
+            // Исходный алгоритм отвечает 0 на пустое слово, автомат -- так же
+            return Evaluation{word.empty() ? 0 : compiledAutomaton().longestFactorOfValidWord(word), false};
+        }
+        if (plan.getEngine() == ENGINE_FINITE) {
+            // Индекс строится и для пустого слова: для бесконечного языка Engine::Finite -- ошибка
+            const FiniteLanguageIndex &index = finite.get([this]() {
+                return FiniteLanguageIndex(canonical, TuningConfig::current().finiteLanguageLimit);
+            });
+            return Evaluation{word.empty() ? 0 : index.longestFactor(word), false};
+        }
+
+        EvaluationBudget budget = EvaluationBudget::work(options.workBudget);
+        if (options.deadlineMilliseconds != 0) {
+            budget = EvaluationBudget::timeout(std::chrono::milliseconds(options.deadlineMilliseconds),
+                                               options.workBudget);
+        }
+        Solver solver(operandExpression, word);
+        PartialAnswer answer = solver.solveWithin(budget, options.memoryLimitBytes);
+        return Evaluation{answer.length, answer.partial};
+    }
+};
+
+CompiledRegex::CompiledRegex(std::shared_ptr<const Implementation> implementation) :
+        implementation(std::move(implementation)) {}
+
+CompiledRegex CompiledRegex::compile(std::string_view expression) {
+    try {
+        return CompiledRegex(std::make_shared<const Implementation>(canonicalizeExpression(expression)));
+    } catch (const ParseException &e) {
+        throw Error(e.what());
+    }
+}
+
+CompiledRegex CompiledRegex::load(const std::string &path) {
+    try {
+        return CompiledRegex(std::make_shared<const Implementation>(CompiledExpression::load(path)));
+    } catch (const ParseException &e) {
+        throw Error(e.what());
+    }
+}
+
+void CompiledRegex::save(const std::string &path) const {
+    try {
+        implementation->compiledAutomaton().save(path);
+    } catch (const ParseException &e) {
+        throw Error(e.what());
+    }
+}
+
+std::string_view CompiledRegex::expression() const {
+    return implementation->canonical;
+}
+
+unsigned long CompiledRegex::evaluate(std::string_view word) const {
+    return evaluate(word, EvaluationOptions()).length;
+}
+
+Evaluation CompiledRegex::evaluate(std::string_view word, const EvaluationOptions &options) const {
+    try {
+        if (!word.empty()) {
+            validateWord(word);
+        }
+        return implementation->evaluateValidWord(word, options);
+    } catch (const ParseException &e) {
+        throw Error(e.what());
+    } catch (const MemoryLimitException &e) {
+        throw MemoryLimitError(e.what());
+    }
+}
+
+std::vector<unsigned long> CompiledRegex::evaluateBatch(const std::vector<std::string_view> &words,
+                                                        unsigned long threadCount) const {
+    std::vector<Evaluation> evaluations = evaluateBatch(words, EvaluationOptions(), threadCount);
+    std::vector<unsigned long> answers(evaluations.size());
+    for (ulong i = 0; i < evaluations.size(); ++i) {
+        answers[i] = evaluations[i].length;
+    }
+    return answers;
+}
+
+std::vector<Evaluation> CompiledRegex::evaluateBatch(const std::vector<std::string_view> &words,
+                                                     const EvaluationOptions &options,
+                                                     unsigned long threadCount) const {
+    try {
+        for (std::string_view word : words) {
+            if (!word.empty()) {
+                validateWord(word);
+            }
+        }
+    } catch (const ParseException &e) {
+        throw Error(e.what());
+    }
+
+    std::vector<Evaluation> answers(words.size());
+    threadCount = std::max(1UL, std::min(threadCount, static_cast<unsigned long>(words.size())));
+
+    // Ошибка в потоке (предел памяти, бесконечный язык у Engine::Finite) останавливает только
+    // его часть слов и бросается после ожидания всех потоков
+    std::vector<std::exception_ptr> failures(threadCount);
+    auto evaluateRange = [&](ulong worker, ulong begin, ulong end) {
+        try {
+            for (ulong i = begin; i < end; ++i) {
+                answers[i] = implementation->evaluateValidWord(words[i], options);
+            }
+        } catch (...) {
+            failures[worker] = std::current_exception();
+        }
+    };
+
+    std::vector<std::thread> workers;
+    ulong chunk = (words.size() + threadCount - 1) / threadCount;
+    for (ulong begin = chunk; begin < words.size(); begin += chunk) {
+        workers.emplace_back(evaluateRange, workers.size() + 1, begin,
+                             std::min(begin + chunk, static_cast<ulong>(words.size())));
+    }
+    evaluateRange(0, 0, std::min(chunk, static_cast<ulong>(words.size())));
+    for (std::thread &worker : workers) {
+        worker.join();
+    }
+
+    try {
+        for (const std::exception_ptr &failure : failures) {
+            if (failure) {
+                std::rethrow_exception(failure);
+            }
+        }
+    } catch (const ParseException &e) {
+        throw Error(e.what());
+    } catch (const MemoryLimitException &e) {
+        throw MemoryLimitError(e.what());
+    }
+
+    return answers;
+}
+
+} // namespace formal_language
+
+struct fl_regex {
+    formal_language::CompiledRegex regex;
+};
+
+namespace {
+
+void reportError(const char *message, char *error, size_t errorSize) {
+    if (error != nullptr && errorSize > 0) {
+        std::strncpy(error, message, errorSize - 1);
+        error[errorSize - 1] = '\0';
+    }
+}
+
+} // namespace
+
+extern "C" {
+
+fl_regex *fl_compile(const char *expression, size_t length, char *error, size_t errorSize) {
+    try {
+        return new fl_regex{formal_language::CompiledRegex::compile(std::string_view(expression, length))};
+    } catch (const std::exception &e) {
+        reportError(e.what(), error, errorSize);
+        return nullptr;
+    }
+}
+
+fl_regex *fl_load(const char *path, char *error, size_t errorSize) {
+    try {
+        return new fl_regex{formal_language::CompiledRegex::load(path)};
+    } catch (const std::exception &e) {
+        reportError(e.what(), error, errorSize);
+        return nullptr;
+    }
+}
+
+int fl_save(const fl_regex *regex, const char *path, char *error, size_t errorSize) {
+    try {
+        regex->regex.save(path);
+        return 0;
+    } catch (const std::exception &e) {
+        reportError(e.what(), error, errorSize);
+        return -1;
+    }
+}
+
+long fl_evaluate(const fl_regex *regex, const char *word, size_t length, char *error, size_t errorSize) {
+    try {
+        return static_cast<long>(regex->regex.evaluate(std::string_view(word, length)));
+    } catch (const std::exception &e) {
+        reportError(e.what(), error, errorSize);
+        return -1;
+    }
+}
+
+int fl_evaluate_batch(const fl_regex *regex, const char *const *words, const size_t *lengths, size_t count,
+                      unsigned long *answers, size_t threadCount, char *error, size_t errorSize) {
+    try {
+        std::vector<std::string_view> views;
+        views.reserve(count);
+        for (size_t i = 0; i < count; ++i) {
+            views.emplace_back(words[i], lengths[i]);
+        }
+        std::vector<unsigned long> results = regex->regex.evaluateBatch(views, threadCount);
+        std::copy(results.begin(), results.end(), answers);
+        return 0;
+    } catch (const std::exception &e) {
+        reportError(e.what(), error, errorSize);
+        return -1;
+    }
+}
+
+long fl_evaluate_within(const fl_regex *regex, const char *word, size_t length, unsigned long deadlineMilliseconds,
+                        unsigned long memoryLimitBytes, int *partial, char *error, size_t errorSize) {
+    try {
+        formal_language::EvaluationOptions options;
+        options.deadlineMilliseconds = deadlineMilliseconds;
+        options.memoryLimitBytes = memoryLimitBytes;
+        formal_language::Evaluation result = regex->regex.evaluate(std::string_view(word, length), options);
+        if (partial != nullptr) {
+            *partial = result.partial ? 1 : 0;
+        }
+        return static_cast<long>(result.length);
+    } catch (const formal_language::MemoryLimitError &e) {
+        reportError(e.what(), error, errorSize);
+        return -2;
+    } catch (const std::exception &e) {
+        reportError(e.what(), error, errorSize);
+        return -1;
+    }
+}
+
+int fl_evaluate_batch_within(const fl_regex *regex, const char *const *words, const size_t *lengths, size_t count,
+                             unsigned long deadlineMilliseconds, unsigned long memoryLimitBytes,
+                             unsigned long *answers, int *partial, size_t threadCount, char *error,
+                             size_t errorSize) {
+    try {
+        std::vector<std::string_view> views;
+        views.reserve(count);
+        for (size_t i = 0; i < count; ++i) {
+            views.emplace_back(words[i], lengths[i]);
+        }
+        formal_language::EvaluationOptions options;
+        options.deadlineMilliseconds = deadlineMilliseconds;
+        options.memoryLimitBytes = memoryLimitBytes;
+        std::vector<formal_language::Evaluation> results = regex->regex.evaluateBatch(views, options, threadCount);
+        for (size_t i = 0; i < count; ++i) {
+            answers[i] = results[i].length;
+            if (partial != nullptr) {
+                partial[i] = results[i].partial ? 1 : 0;
+            }
+        }
+        return 0;
+    } catch (const formal_language::MemoryLimitError &e) {
+        reportError(e.what(), error, errorSize);
+        return -2;
+    } catch (const std::exception &e) {
+        reportError(e.what(), error, errorSize);
+        return -1;
+    }
+}
+
+void fl_free(fl_regex *regex) {
+    delete regex;
+}
+
+}
@@ -0,0 +1,136 @@
+#ifndef FORMAL_LANGUAGE_H
+#define FORMAL_LANGUAGE_H
+
+// Публичный интерфейс библиотеки: по регулярному выражению alpha в обратной польской
+// записи над алфавитом {a, b, c, 1, ., +, *} и слову u над {a, b, c} находит длину самого
+// длинного подслова u, являющегося также подсловом некоторого слова из L(alpha)
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace formal_language {
+
+// Ошибка разбора выражения или слова, а также ошибка чтения файла скомпилированного выражения
+struct Error : public std::runtime_error {
+    explicit Error(const std::string &message) : std::runtime_error(message) {}
+};
+
+// Таблицам Operand понадобилось больше EvaluationOptions::memoryLimitBytes байт
+struct MemoryLimitError : public Error {
+    explicit MemoryLimitError(const std::string &message) : Error(message) {}
+};
+
+// Движок запроса: по умолчанию выбирается по оценке стоимости для длины слова
+enum class Engine {
+    Auto,
+    Operand,   // исходный алгоритм по подсловам
+    Automaton, // автомат позиций
+    Finite     // суффиксный автомат конечного языка; для бесконечного языка -- Error
+};
+
+// Ограничения запроса (0 -- без ограничения). Срок, бюджет работы в ячейках таблиц и предел
+// памяти относятся к движку Operand: автоматы отвечают за один проход по слову
+struct EvaluationOptions {
+    Engine engine = Engine::Auto;
+    unsigned long deadlineMilliseconds = 0;
+    unsigned long workBudget = 0;
+    unsigned long memoryLimitBytes = 0;
+};
+
+// При partial == true срок или бюджет истёк, и length -- доказанная нижняя граница ответа
+struct Evaluation {
+    unsigned long length;
+    bool partial;
+};
+
+// Скомпилированное выражение. Движок каждого запроса выбирается, как в solution, по оценке
+// стоимости (planner.h); таблицы автоматов строятся при первом запросе, которому они нужны.
+// Копирование дешёвое (таблицы общие), методы потокобезопасны
+class CompiledRegex {
+public:
+    // Проверяет и компилирует выражение
+    static CompiledRegex compile(std::string_view expression);
+
+    // Загружает выражение, записанное save, отображением файла в память
+    static CompiledRegex load(const std::string &path);
+
+    void save(const std::string &path) const;
+
+    // Каноническая запись выражения
+    std::string_view expression() const;
+
+    // На пустое слово ответ 0
+    unsigned long evaluate(std::string_view word) const;
+
+    // Движок выбирается по options.engine; MemoryLimitError при превышении предела памяти
+    Evaluation evaluate(std::string_view word, const EvaluationOptions &options) const;
+
+    // Ответы для всех слов по порядку; слова делятся между threadCount потоками
+    std::vector<unsigned long> evaluateBatch(const std::vector<std::string_view> &words,
+                                             unsigned long threadCount = 1) const;
+
+    // То же с ограничениями; срок и бюджет отсчитываются для каждого слова отдельно
+    std::vector<Evaluation> evaluateBatch(const std::vector<std::string_view> &words,
+                                          const EvaluationOptions &options, unsigned long threadCount = 1) const;
+
+    struct Implementation;
+
+private:
+    explicit CompiledRegex(std::shared_ptr<const Implementation> implementation);
+
+    std::shared_ptr<const Implementation> implementation;
+};
+
+} // namespace formal_language
+
+extern "C" {
+#endif
+
+// Интерфейс на C. Функции, принимающие error, при ошибке записывают в него сообщение
+// (не более errorSize байт вместе с завершающим нулём); error может быть NULL
+
+typedef struct fl_regex fl_regex;
+
+// NULL при ошибке
+fl_regex *fl_compile(const char *expression, size_t length, char *error, size_t errorSize);
+
+// NULL при ошибке
+fl_regex *fl_load(const char *path, char *error, size_t errorSize);
+
+// 0 при успехе, -1 при ошибке
+int fl_save(const fl_regex *regex, const char *path, char *error, size_t errorSize);
+
+// Длина подслова или -1 при ошибке
+long fl_evaluate(const fl_regex *regex, const char *word, size_t length, char *error, size_t errorSize);
+
+// Записывает в answers[i] ответ для слова words[i] длины lengths[i]; 0 при успехе, -1 при ошибке
+int fl_evaluate_batch(const fl_regex *regex, const char *const *words, const size_t *lengths, size_t count,
+                      unsigned long *answers, size_t threadCount, char *error, size_t errorSize);
+
+// Вычисление со сроком deadlineMilliseconds и пределом памяти таблиц memoryLimitBytes (0 -- без
+// ограничения). Если срок истёк, *partial (может быть NULL) равен 1, а ответ -- доказанная нижняя
+// граница. Длина подслова, -1 при ошибке или -2 при превышении предела памяти
+long fl_evaluate_within(const fl_regex *regex, const char *word, size_t length, unsigned long deadlineMilliseconds,
+                        unsigned long memoryLimitBytes, int *partial, char *error, size_t errorSize);
+
+// То же для всех слов: partial[i] (partial может быть NULL) -- признак частичного ответа answers[i];
+// 0 при успехе, -1 при ошибке, -2 при превышении предела памяти
+int fl_evaluate_batch_within(const fl_regex *regex, const char *const *words, const size_t *lengths, size_t count,
+                             unsigned long deadlineMilliseconds, unsigned long memoryLimitBytes,
+                             unsigned long *answers, int *partial, size_t threadCount, char *error,
+                             size_t errorSize);
+
+void fl_free(fl_regex *regex);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // FORMAL_LANGUAGE_H
@@ -0,0 +1,161 @@
+#ifndef FORMAL_LANGUAGE_INPUT_H
+#define FORMAL_LANGUAGE_INPUT_H
+
+// Чтение входа через отображение файлов в память
+
+#include <vector>
+#include <cctype>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "common.h"
+
+// Входной файл, отображённый в память. Выражение и слово выдаются как string_view
+// на отображённые байты без копирования. Если файл нельзя отобразить (например, это
+// канал), он целиком читается в буфер
+struct MappedInput {
+private:
+    const char *data;
+    ulong size;
+    ulong position;
+    bool mapped;
+    std::vector<char> buffer;
+
+    void readAll(int fd) {
+        char block[STREAM_BLOCK_SIZE];
+        while (true) {
+            ssize_t bytesRead = read(fd, block, sizeof(block));
+            if (bytesRead < 0 && errno == EINTR) {
+                continue;
+            }
+            if (bytesRead <= 0) {
+                break;
+            }
+            buffer.insert(buffer.end(), block, block + bytesRead);
+        }
+        data = buffer.data();
+        size = buffer.size();
+    }
+
+public:
+    explicit MappedInput(const char *path) : data(nullptr), size(0), position(0), mapped(false) {
+        int fd = open(path, O_RDONLY);
+        if (fd < 0) {
+            throw ParseException(string("Cannot open ") + path + ": " + std::strerror(errno));
+        }
+
+        struct stat status;
+        if (fstat(fd, &status) == 0 && S_ISREG(status.st_mode) && status.st_size > 0) {
+            void *address = mmap(nullptr, static_cast<size_t>(status.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+            if (address != MAP_FAILED) {
+                madvise(address, static_cast<size_t>(status.st_size), MADV_SEQUENTIAL);
+                data = static_cast<const char *>(address);
+                size = static_cast<ulong>(status.st_size);
+                mapped = true;
+            }
+        }
+        if (!mapped) {
+            readAll(fd);
+        }
+        close(fd);
+    }
+
+    MappedInput(const MappedInput &) = delete;
+    MappedInput &operator=(const MappedInput &) = delete;
+
+    ~MappedInput() {
+        if (mapped) {
+            munmap(const_cast<char *>(data), size);
+        }
+    }
+
+    // Следующее слово, разделённое пробельными символами; пустое, если вход закончился
+    string_view nextToken() {
+        while (position < size && std::isspace(static_cast<unsigned char>(data[position]))) {
+            ++position;
+        }
+        ulong begin = position;
+        while (position < size && !std::isspace(static_cast<unsigned char>(data[position]))) {
+            ++position;
+        }
+        return string_view(data + begin, position - begin);
+    }
+
+    bool finished() const {
+        return position >= size;
+    }
+
+    // Следующая строка без символа перевода строки
+    string_view nextLine() {
+        ulong begin = position;
+        while (position < size && data[position] != '\n') {
+            ++position;
+        }
+        string_view line(data + begin, position - begin);
+        if (position < size) {
+            ++position;
+        }
+        return line;
+    }
+
+    // Отрезает от строки line первое слово, разделённое пробельными символами
+    static string_view splitToken(string_view &line) {
+        ulong begin = 0;
+        while (begin < line.length() && std::isspace(static_cast<unsigned char>(line[begin]))) {
+            ++begin;
+        }
+        ulong end = begin;
+        while (end < line.length() && !std::isspace(static_cast<unsigned char>(line[end]))) {
+            ++end;
+        }
+        string_view token = line.substr(begin, end - begin);
+        line.remove_prefix(end);
+        return token;
+    }
+};
+
+// Область файла, отображённая в память только для чтения
+struct MappedRegion {
+private:
+    const char *data;
+    ulong size;
+
+public:
+    explicit MappedRegion(const string &path) : data(nullptr), size(0) {
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            throw ParseException("Cannot open " + path + ": " + std::strerror(errno));
+        }
+        struct stat status;
+        if (fstat(fd, &status) != 0 || status.st_size <= 0) {
+            close(fd);
+            throw ParseException("Cannot map empty file " + path);
+        }
+        void *address = mmap(nullptr, static_cast<size_t>(status.st_size), PROT_READ, MAP_SHARED, fd, 0);
+        close(fd);
+        if (address == MAP_FAILED) {
+            throw ParseException("Cannot map " + path + ": " + std::strerror(errno));
+        }
+        data = static_cast<const char *>(address);
+        size = static_cast<ulong>(status.st_size);
+    }
+
+    MappedRegion(const MappedRegion &) = delete;
+    MappedRegion &operator=(const MappedRegion &) = delete;
+
+    ~MappedRegion() {
+        munmap(const_cast<char *>(data), size);
+    }
+
+    const char *getData() const {
+        return data;
+    }
+
+    ulong getSize() const {
+        return size;
+    }
+};
+
+#endif // FORMAL_LANGUAGE_INPUT_H
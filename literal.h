@@ -0,0 +1,236 @@
+#ifndef FORMAL_LANGUAGE_LITERAL_H
+#define FORMAL_LANGUAGE_LITERAL_H
+
+// Литералы в выражении: подвыражение из одних букв и конкатенаций (ab.c.a.b.) задаёт одно
+// слово w, а звёздочка над ним -- язык w*. Таблицы операндов для них не строятся цепочкой
+// конкатенаций и 2n + 2 итерациями звёздочки: они получаются сопоставлением w со словом
+// z-функцией за O(n + |w|) плюс число верных ячеек
+
+#include <vector>
+#include <memory>
+#include <algorithm>
+
+#include "common.h"
+#include "operand_memory.h"
+
+// Подвыражение-литерал в записи выражения: символы [begin, end)
+struct LiteralSpan {
+    ulong begin;
+    ulong end;
+    string literal;
+    bool star; // подвыражение -- literal*
+};
+
+typedef std::vector<LiteralSpan> LiteralSpans;
+
+// Наибольшие по включению подвыражения-литералы длины не меньше 2 и литералы под звёздочкой
+// в порядке записи. У некорректной записи список пуст: об ошибке сообщит вычисление
+inline std::shared_ptr<const LiteralSpans> findLiteralSpans(string_view expression) {
+    struct Term {
+        ulong begin;
+        bool literal;
+        bool star;
+        string word;
+    };
+    std::vector<Term> terms;
+    auto spans = std::make_shared<LiteralSpans>();
+    auto keep = [&](const Term &term, ulong end) {
+        if (term.literal && (term.star || term.word.length() >= 2)) {
+            spans->push_back(LiteralSpan{term.begin, end, term.word, term.star});
+        }
+    };
+
+    for (ulong i = 0; i < expression.length(); ++i) {
+        char character = expression[i];
+        if (character >= 'a' && character <= 'c') {
+            terms.push_back(Term{i, true, false, string(1, character)});
+        } else if (character == EPSILON) {
+            terms.push_back(Term{i, false, false, ""});
+        } else if (character == '*') {
+            if (terms.empty()) {
+                return std::make_shared<LiteralSpans>();
+            }
+            if (terms.back().literal) {
+                terms.back().star = true; // (w*)* = w*
+            }
+        } else if (character == '+' || character == '.') {
+            if (terms.size() < 2) {
+                return std::make_shared<LiteralSpans>();
+            }
+            Term right = terms.back();
+            terms.pop_back();
+            Term &left = terms.back();
+            if (character == '.' && left.literal && right.literal && !left.star && !right.star) {
+                left.word += right.word;
+                continue;
+            }
+            keep(left, right.begin);
+            keep(right, i);
+            left = Term{left.begin, false, false, ""};
+        } else {
+            return std::make_shared<LiteralSpans>();
+        }
+    }
+    if (terms.size() != 1) {
+        return std::make_shared<LiteralSpans>();
+    }
+    keep(terms.back(), expression.length());
+
+    std::sort(spans->begin(), spans->end(), [](const LiteralSpan &first, const LiteralSpan &second) {
+        return first.begin < second.begin;
+    });
+    return spans;
+}
+
+// Таблицы операнда (в смысле Operand) для литерала w или w* на слове word
+struct LiteralTables {
+    OperandIntervals substrings;              // упорядочены, без повторов
+    std::vector<ulong> suffixEqualsToPrefix;  // длины префиксов word, меньшие word.length()
+    std::vector<ulong> prefixEqualsToSuffix;  // длины суффиксов word, меньшие word.length()
+    bool containsEpsilon;
+    bool containsWordAsSubstring;
+
+private:
+    // Рабочая память compute, переиспользуемая между вызовами
+    string joined;
+    std::vector<ulong> z;
+    std::vector<ulong> wordMatches;
+    std::vector<ulong> literalMatches;
+    std::vector<ulong> runs;
+    std::vector<ulong> runsBefore;
+    std::vector<bool> prefixes;
+    std::vector<bool> suffixes;
+    string repeated;
+
+    // matches[i] -- длина наибольшего общего префикса text[i, ...) и pattern (z-функция pattern#text)
+    void prefixMatchLengths(string_view pattern, string_view text, std::vector<ulong> &matches) {
+        joined.assign(pattern.data(), pattern.length());
+        joined += '#';
+        joined.append(text.data(), text.length());
+        z.assign(joined.length(), 0);
+        for (ulong i = 1, left = 0, right = 0; i < joined.length(); ++i) {
+            if (i < right) {
+                z[i] = std::min(right - i, z[i - left]);
+            }
+            while (i + z[i] < joined.length() && joined[z[i]] == joined[i + z[i]]) {
+                ++z[i];
+            }
+            if (i + z[i] > right) {
+                left = i;
+                right = i + z[i];
+            }
+        }
+        matches.assign(z.begin() + static_cast<long>(pattern.length()) + 1, z.end());
+    }
+
+public:
+    LiteralTables() : containsEpsilon(false), containsWordAsSubstring(false) {}
+
+    LiteralTables(const LiteralSpan &span, string_view word) : LiteralTables() {
+        compute(span, word);
+    }
+
+    void compute(const LiteralSpan &span, string_view word) {
+        substrings.clear();
+        suffixEqualsToPrefix.clear();
+        prefixEqualsToSuffix.clear();
+        containsEpsilon = span.star;
+        containsWordAsSubstring = false;
+
+        string_view literal = span.literal;
+        ulong literalLength = literal.length();
+        ulong wordLength = word.length();
+
+        // wordMatches[i] -- общий префикс word[i, ...) и w; literalMatches[t] -- общий префикс w[t, ...) и word
+        prefixMatchLengths(literal, word, wordMatches);
+        prefixMatchLengths(word, literal, literalMatches);
+        auto occurs = [&](ulong start) {
+            return start + literalLength <= wordLength && wordMatches[start] >= literalLength;
+        };
+
+        if (!span.star) {
+            for (ulong start = 0; start < wordLength; ++start) {
+                if (occurs(start)) {
+                    substrings.push_back(OperandInterval{static_cast<unsigned>(start),
+                                                         static_cast<unsigned>(literalLength)});
+                }
+            }
+            // Префикс word длины length -- суффикс w, суффикс word длины length -- префикс w
+            for (ulong length = 1; length < wordLength && length <= literalLength; ++length) {
+                if (literalMatches[literalLength - length] >= length) {
+                    suffixEqualsToPrefix.push_back(length);
+                }
+                if (wordMatches[wordLength - length] >= length) {
+                    prefixEqualsToSuffix.push_back(length);
+                }
+            }
+            for (ulong start = 0; start < literalLength && !containsWordAsSubstring; ++start) {
+                containsWordAsSubstring = literalMatches[start] >= wordLength;
+            }
+            return;
+        }
+
+        // runs[i] -- число вхождений w подряд, начиная с i; runsBefore[i] -- подряд, заканчивая в i
+        runs.assign(wordLength + 1, 0);
+        runsBefore.assign(wordLength + 1, 0);
+        for (ulong start = wordLength; start-- > 0;) {
+            if (occurs(start)) {
+                runs[start] = 1 + runs[start + literalLength];
+            }
+        }
+        for (ulong end = literalLength; end <= wordLength; ++end) {
+            if (occurs(end - literalLength)) {
+                runsBefore[end] = 1 + runsBefore[end - literalLength];
+            }
+        }
+
+        // Подслова w^j: цепочки вхождений
+        for (ulong start = 0; start < wordLength; ++start) {
+            for (ulong count = 1; count <= runs[start]; ++count) {
+                substrings.push_back(OperandInterval{static_cast<unsigned>(start),
+                                                     static_cast<unsigned>(count * literalLength)});
+            }
+        }
+
+        // Префикс word -- суффикс w длины tail (или пусто), за которым j копий w
+        prefixes.assign(wordLength + 1, false);
+        suffixes.assign(wordLength + 1, false);
+        for (ulong tail = 0; tail <= literalLength && tail < wordLength; ++tail) {
+            if (tail > 0 && literalMatches[literalLength - tail] < tail) {
+                continue;
+            }
+            for (ulong count = 0; count <= runs[tail]; ++count) {
+                prefixes[tail + count * literalLength] = true;
+            }
+        }
+        // Суффикс word -- j копий w, за которыми префикс w длины head (или пусто)
+        for (ulong head = 0; head <= literalLength && head < wordLength; ++head) {
+            if (head > 0 && wordMatches[wordLength - head] < head) {
+                continue;
+            }
+            for (ulong count = 0; count <= runsBefore[wordLength - head]; ++count) {
+                suffixes[head + count * literalLength] = true;
+            }
+        }
+        for (ulong length = 1; length < wordLength; ++length) {
+            if (prefixes[length]) {
+                suffixEqualsToPrefix.push_back(length);
+            }
+            if (suffixes[length]) {
+                prefixEqualsToSuffix.push_back(length);
+            }
+        }
+
+        // word -- подслово какого-то w^j, то есть подслово w, повторённого до длины |word| + |w|
+        repeated.clear();
+        while (repeated.length() < wordLength + literalLength) {
+            repeated += span.literal;
+        }
+        prefixMatchLengths(word, repeated, literalMatches);
+        for (ulong start = 0; start < literalLength && !containsWordAsSubstring; ++start) {
+            containsWordAsSubstring = literalMatches[start] >= wordLength;
+        }
+    }
+};
+
+#endif // FORMAL_LANGUAGE_LITERAL_H
@@ -0,0 +1,237 @@
+#ifndef FORMAL_LANGUAGE_METRICS_H
+#define FORMAL_LANGUAGE_METRICS_H
+
+// Метрики сервера запросов в текстовом формате Prometheus. Счётчики лежат в общей анонимной
+// области памяти, созданной до fork, поэтому все процессы сервера пишут в одни счётчики
+// (атомарными операциями, как в ResultCache), а отдаёт их любой процесс
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <sys/mman.h>
+
+#include "common.h"
+#include "trace.h"
+
+struct ServerMetrics {
+public:
+    // Причины отказа: начала сообщений ParseException и соответствующие метки (последняя -- прочие)
+    static const ulong REJECT_REASON_COUNT = 8;
+
+    static const ulong LATENCY_BUCKET_COUNT = 18;
+
+private:
+    struct Counters {
+        ulong queries[TRACE_RESULT_CACHE + 1]; // по движкам TraceEngine
+        ulong latencyBuckets[LATENCY_BUCKET_COUNT + 1]; // без накопления; последняя -- +Inf
+        ulong latencySumNanoseconds;
+        ulong compileCacheHits;
+        ulong compileCacheMisses;
+        ulong starIterations;
+        ulong operandTableBytes;
+        ulong rejected[REJECT_REASON_COUNT];
+    };
+
+    Counters *counters;
+
+    static const double *latencyBounds() {
+        static const double bounds[LATENCY_BUCKET_COUNT] = {
+                1e-6, 2.5e-6, 5e-6, 1e-5, 2.5e-5, 5e-5, 1e-4, 2.5e-4, 5e-4,
+                1e-3, 2.5e-3, 5e-3, 1e-2, 2.5e-2, 5e-2, 0.1, 1, 10};
+        return bounds;
+    }
+
+    struct RejectReason {
+        const char *prefix;
+        const char *label;
+    };
+
+    static const RejectReason *rejectReasons() {
+        static const RejectReason reasons[REJECT_REASON_COUNT] = {
+                {"Expression is empty", "expression_empty"},
+                {"Missing operands", "missing_operands"},
+                {"Too much operands", "too_much_operands"},
+                {"Unknown symbol in expression", "unknown_symbol_in_expression"},
+                {"Unknown operator symbol", "unknown_operator_symbol"},
+                {"Word is empty", "word_empty"},
+                {"Unknown symbol in word", "unknown_symbol_in_word"},
+                {"", "other"}};
+        return reasons;
+    }
+
+    static void add(ulong &counter, ulong value) {
+        __atomic_add_fetch(&counter, value, __ATOMIC_RELAXED);
+    }
+
+    static ulong load(const ulong &counter) {
+        return __atomic_load_n(&counter, __ATOMIC_RELAXED);
+    }
+
+    void recordLatency(std::chrono::steady_clock::duration latency) {
+        double seconds = std::chrono::duration<double>(latency).count();
+        ulong bucket = 0;
+        while (bucket < LATENCY_BUCKET_COUNT && seconds > latencyBounds()[bucket]) {
+            ++bucket;
+        }
+        add(counters->latencyBuckets[bucket], 1);
+        add(counters->latencySumNanoseconds,
+            static_cast<ulong>(std::chrono::duration_cast<std::chrono::nanoseconds>(latency).count()));
+    }
+
+    static void appendCounter(string &output, const char *name, const char *help, ulong value) {
+        output += string("# HELP ") + name + " " + help + "\n# TYPE " + name + " counter\n" + name + " "
+                  + std::to_string(value) + "\n";
+    }
+
+public:
+    ServerMetrics() {
+        void *address = mmap(nullptr, sizeof(Counters), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+        if (address == MAP_FAILED) {
+            throw ParseException(string("Cannot map metrics: ") + std::strerror(errno));
+        }
+        counters = static_cast<Counters *>(address);
+    }
+
+    ServerMetrics(const ServerMetrics &) = delete;
+    ServerMetrics &operator=(const ServerMetrics &) = delete;
+
+    ~ServerMetrics() {
+        munmap(counters, sizeof(Counters));
+    }
+
+    // Ответ движка engine
+    void recordQuery(TraceEngine engine, std::chrono::steady_clock::duration latency) {
+        add(counters->queries[engine], 1);
+        recordLatency(latency);
+    }
+
+    // Отказ с сообщением ParseException
+    void recordRejected(const string &message, std::chrono::steady_clock::duration latency) {
+        ulong reason = 0;
+        while (reason + 1 < REJECT_REASON_COUNT
+               && message.compare(0, std::strlen(rejectReasons()[reason].prefix), rejectReasons()[reason].prefix)
+                  != 0) {
+            ++reason;
+        }
+        add(counters->rejected[reason], 1);
+        recordLatency(latency);
+    }
+
+    void recordCompileCache(bool hit) {
+        add(hit ? counters->compileCacheHits : counters->compileCacheMisses, 1);
+    }
+
+    // Работа движка Operand: итерации звёздочки Клини и байты выделенных таблиц
+    void recordOperandWork(ulong starIterations, ulong tableBytes) {
+        add(counters->starIterations, starIterations);
+        add(counters->operandTableBytes, tableBytes);
+    }
+
+    // Все метрики в текстовом формате Prometheus
+    string render() const {
+        string output;
+
+        output += "# HELP formal_language_queries_total Answered queries by engine.\n"
+                  "# TYPE formal_language_queries_total counter\n";
+        for (ulong engine = 0; engine <= TRACE_RESULT_CACHE; ++engine) {
+            output += string("formal_language_queries_total{engine=\"")
+                      + traceEngineName(static_cast<TraceEngine>(engine)) + "\"} "
+                      + std::to_string(load(counters->queries[engine])) + "\n";
+        }
+
+        output += "# HELP formal_language_query_duration_seconds Latency of answered and rejected queries.\n"
+                  "# TYPE formal_language_query_duration_seconds histogram\n";
+        ulong cumulative = 0;
+        char bound[32];
+        for (ulong bucket = 0; bucket <= LATENCY_BUCKET_COUNT; ++bucket) {
+            cumulative += load(counters->latencyBuckets[bucket]);
+            if (bucket < LATENCY_BUCKET_COUNT) {
+                std::snprintf(bound, sizeof(bound), "%g", latencyBounds()[bucket]);
+            } else {
+                std::snprintf(bound, sizeof(bound), "+Inf");
+            }
+            output += string("formal_language_query_duration_seconds_bucket{le=\"") + bound + "\"} "
+                      + std::to_string(cumulative) + "\n";
+        }
+        char sum[32];
+        std::snprintf(sum, sizeof(sum), "%.9f", load(counters->latencySumNanoseconds) / 1e9);
+        output += string("formal_language_query_duration_seconds_sum ") + sum + "\n"
+                  + "formal_language_query_duration_seconds_count " + std::to_string(cumulative) + "\n";
+
+        appendCounter(output, "formal_language_compile_cache_hits_total", "Compiled expression cache hits.",
+                      load(counters->compileCacheHits));
+        appendCounter(output, "formal_language_compile_cache_misses_total", "Compiled expression cache misses.",
+                      load(counters->compileCacheMisses));
+        appendCounter(output, "formal_language_star_iterations_total",
+                      "Kleene star iterations executed by the Operand engine.", load(counters->starIterations));
+        appendCounter(output, "formal_language_operand_table_bytes_total",
+                      "Bytes of Operand tables allocated by the Operand engine.", load(counters->operandTableBytes));
+
+        output += "# HELP formal_language_rejected_queries_total Queries rejected by a parse error, by reason.\n"
+                  "# TYPE formal_language_rejected_queries_total counter\n";
+        for (ulong reason = 0; reason < REJECT_REASON_COUNT; ++reason) {
+            output += string("formal_language_rejected_queries_total{reason=\"") + rejectReasons()[reason].label
+                      + "\"} " + std::to_string(load(counters->rejected[reason])) + "\n";
+        }
+        return output;
+    }
+};
+
+// Поток, который раз в intervalSeconds секунд переписывает файл метрик (например, для textfile-коллектора
+// node_exporter). Файл заменяется атомарно через rename
+struct MetricsFileWriter {
+private:
+    const ServerMetrics &metrics;
+    string path;
+    std::chrono::duration<double> interval;
+    std::mutex mutex;
+    std::condition_variable stopRequested;
+    bool stopping;
+    std::thread writer;
+
+    void write() {
+        string temporaryPath;
+        int fd = createTemporaryFile(path, temporaryPath);
+        if (fd < 0) {
+            return;
+        }
+        bool written = writeAll(fd, metrics.render());
+        close(fd);
+        if (!written || rename(temporaryPath.c_str(), path.c_str()) != 0) {
+            unlink(temporaryPath.c_str());
+        }
+    }
+
+    void run() {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            write();
+            if (stopRequested.wait_for(lock, interval, [this] { return stopping; })) {
+                write();
+                return;
+            }
+        }
+    }
+
+public:
+    MetricsFileWriter(const ServerMetrics &metrics, const string &path, double intervalSeconds) :
+            metrics(metrics), path(path), interval(max(intervalSeconds, 0.01)), stopping(false),
+            writer(&MetricsFileWriter::run, this) {}
+
+    MetricsFileWriter(const MetricsFileWriter &) = delete;
+    MetricsFileWriter &operator=(const MetricsFileWriter &) = delete;
+
+    ~MetricsFileWriter() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        stopRequested.notify_all();
+        writer.join();
+    }
+};
+
+#endif // FORMAL_LANGUAGE_METRICS_H
@@ -0,0 +1,1037 @@
+#ifndef FORMAL_LANGUAGE_OPERAND_H
+#define FORMAL_LANGUAGE_OPERAND_H
+
+// Исходный алгоритм: таблицы подслов для операндов выражения и перебор подслов
+
+#include <vector>
+#include <stack>
+#include <set>
+#include <algorithm>
+#include <iterator>
+#include <type_traits>
+#include <cassert>
+
+#include "common.h"
+#include "input.h"
+#include "cancellation.h"
+#include "fixed_operand.h"
+#include "literal.h"
+#include "operand_memory.h"
+#include "operator_trace.h"
+#include "phase_profiler.h"
+#include "semiring.h"
+#include "tuning.h"
+
+enum OperatorType {
+    PLUS,
+    MULTIPLY,
+    KLEENE_STAR
+};
+
+// Структура, описывающая язык L(Operand), соответствующий
+// какому-то регулярному выражению, который является
+// операндом исходного регулярного выражения. Таблицы -- над полукольцом Semiring (semiring.h):
+// в ячейке хранится сумма (plus) весов выводов подслова, вес вывода -- произведение (times)
+// весов листьев выражения, через которые проходит совпадение; части слова языка вне совпадения
+// не учитываются. Общий шаблон хранит таблицы плотными и вычисляет их формулами булева
+// Operand, в которых "или" и "и" заменены на plus и times
+template <typename Semiring>
+struct BasicOperand {
+    typedef typename Semiring::Value Value;
+    typedef std::vector<Value, OperandAllocator<Value> > Table;
+
+private:
+    Table containsSubstring;
+    // containsSubstring[start * (wordLength + 1) + length] -- вес подслова word[start, start + length)
+    // как слова языка
+
+    Table containsSuffixEqualsToPrefix;
+    // containsSuffixEqualsToPrefix[length] -- вес префикса слова длины length как суффикса слова языка
+
+    Table containsPrefixEqualsToSuffix;
+    // containsPrefixEqualsToSuffix[length] -- вес суффикса слова длины length как префикса слова языка
+
+    Value containsEpsilon;
+    Value containsWordAsSubstring;
+
+    ulong wordLength;
+
+    Value &substring(ulong start, ulong length) {
+        return containsSubstring[start * (wordLength + 1) + length];
+    }
+
+    const Value &substring(ulong start, ulong length) const {
+        return containsSubstring[start * (wordLength + 1) + length];
+    }
+
+    static void add(Value &accumulator, Value value) {
+        accumulator = Semiring::plus(accumulator, value);
+    }
+
+public:
+    // Операнд, задающий пустой язык
+    explicit BasicOperand(ulong wordLength) :
+            containsSubstring(wordLength * (wordLength + 1), Semiring::zero()),
+            containsSuffixEqualsToPrefix(wordLength + 1, Semiring::zero()),
+            containsPrefixEqualsToSuffix(wordLength + 1, Semiring::zero()),
+            containsEpsilon(Semiring::zero()), containsWordAsSubstring(Semiring::zero()), wordLength(wordLength) {}
+
+    // Операнд, задающий язык из одного символа с весом weight
+    BasicOperand(char character, string_view word, Value weight) : BasicOperand(word.length()) {
+        if (character == EPSILON) {
+            containsEpsilon = weight;
+            return;
+        }
+        for (ulong startPosition = 0; startPosition < wordLength; ++startPosition) {
+            if (word[startPosition] == character) {
+                substring(startPosition, 1) = weight;
+            }
+        }
+        if (word[0] == character) {
+            containsSuffixEqualsToPrefix[1] = weight;
+        }
+        if (word.back() == character) {
+            containsPrefixEqualsToSuffix[1] = weight;
+        }
+        if (wordLength == 1 && word[0] == character) {
+            containsWordAsSubstring = weight;
+        }
+    }
+
+    BasicOperand(char character, string_view word) : BasicOperand(character, word, Semiring::one()) {}
+
+    bool isWordEqualToSomeSubstringInLanguage() const {
+        return containsWordAsSubstring != Semiring::zero();
+    }
+
+    // Сумма весов вхождений всего слова как подслова слова языка
+    Value wordAsSubstringWeight() const {
+        return containsWordAsSubstring;
+    }
+
+    // Байты, занятые таблицами операнда
+    ulong byteSize() const {
+        return (containsSubstring.capacity() + containsSuffixEqualsToPrefix.capacity()
+                + containsPrefixEqualsToSuffix.capacity()) * sizeof(Value);
+    }
+
+    // Тот же язык без пустого слова: итерация звёздочки
+    void removeEpsilon() {
+        containsEpsilon = Semiring::zero();
+    }
+
+    BasicOperand operator+(const BasicOperand &right) const {
+        BasicOperand left = *this;
+        for (ulong i = 0; i < left.containsSubstring.size(); ++i) {
+            add(left.containsSubstring[i], right.containsSubstring[i]);
+        }
+        for (ulong length = 1; length <= wordLength; ++length) {
+            add(left.containsSuffixEqualsToPrefix[length], right.containsSuffixEqualsToPrefix[length]);
+            add(left.containsPrefixEqualsToSuffix[length], right.containsPrefixEqualsToSuffix[length]);
+        }
+        add(left.containsEpsilon, right.containsEpsilon);
+        add(left.containsWordAsSubstring, right.containsWordAsSubstring);
+        return left;
+    }
+
+    BasicOperand operator*(const BasicOperand &right) const {
+        const BasicOperand &left = *this;
+        CancellationScope::checkpoint(wordLength * (wordLength + 1) / 2);
+        BasicOperand result(wordLength);
+
+        for (ulong startPosition = 0; startPosition < wordLength; ++startPosition) {
+            for (ulong length = 1; startPosition + length <= wordLength; ++length) {
+                result.substring(startPosition, length) =
+                        Semiring::plus(Semiring::times(left.containsEpsilon, right.substring(startPosition, length)),
+                                       Semiring::times(left.substring(startPosition, length), right.containsEpsilon));
+            }
+            for (ulong prefixLength = 1; startPosition + prefixLength < wordLength; ++prefixLength) {
+                Value prefix = left.substring(startPosition, prefixLength);
+                if (prefix == Semiring::zero()) {
+                    continue;
+                }
+                ulong middle = startPosition + prefixLength;
+                for (ulong suffixLength = 1; middle + suffixLength <= wordLength; ++suffixLength) {
+                    add(result.substring(startPosition, prefixLength + suffixLength),
+                        Semiring::times(prefix, right.substring(middle, suffixLength)));
+                }
+            }
+        }
+        result.containsEpsilon = Semiring::times(left.containsEpsilon, right.containsEpsilon);
+
+        result.containsWordAsSubstring = Semiring::plus(left.containsWordAsSubstring, right.containsWordAsSubstring);
+        for (ulong prefixLength = 1; prefixLength < wordLength; ++prefixLength) {
+            add(result.containsWordAsSubstring, Semiring::times(left.containsSuffixEqualsToPrefix[prefixLength],
+                                                                right.containsPrefixEqualsToSuffix[wordLength - prefixLength]));
+        }
+
+        for (ulong prefixLength = 1; prefixLength < wordLength; ++prefixLength) {
+            Value value = Semiring::plus(right.containsSuffixEqualsToPrefix[prefixLength],
+                                         Semiring::times(right.containsEpsilon,
+                                                         left.containsSuffixEqualsToPrefix[prefixLength]));
+            for (ulong subPrefixLength = 1; subPrefixLength < prefixLength; ++subPrefixLength) {
+                add(value, Semiring::times(left.containsSuffixEqualsToPrefix[subPrefixLength],
+                                           right.substring(subPrefixLength, prefixLength - subPrefixLength)));
+            }
+            result.containsSuffixEqualsToPrefix[prefixLength] = value;
+        }
+
+        for (ulong suffixLength = 1; suffixLength < wordLength; ++suffixLength) {
+            ulong startPosition = wordLength - suffixLength;
+            Value value = Semiring::plus(left.containsPrefixEqualsToSuffix[suffixLength],
+                                         Semiring::times(left.containsEpsilon,
+                                                         right.containsPrefixEqualsToSuffix[suffixLength]));
+            for (ulong subSuffixLength = 1; subSuffixLength < suffixLength; ++subSuffixLength) {
+                add(value, Semiring::times(left.substring(startPosition, suffixLength - subSuffixLength),
+                                           right.containsPrefixEqualsToSuffix[subSuffixLength]));
+            }
+            result.containsPrefixEqualsToSuffix[suffixLength] = value;
+        }
+        return result;
+    }
+
+    // Префиксы, суффиксы и всё слово у звёздочки iteration*, подслова которой -- суммы степеней
+    // powers. В сумме степеней совпадение, начинающееся или заканчивающееся внутри итерации,
+    // учтено в каждой степени, где оно встречается; для идемпотентного plus это не важно, а
+    // в общем случае эти таблицы пересчитываются: совпадение начинается суффиксом одной итерации
+    // или заканчивается префиксом одной итерации, а между ними -- подслово звёздочки
+    static BasicOperand completeStar(const BasicOperand &iteration, BasicOperand powers) {
+        powers.containsSuffixEqualsToPrefix.assign(powers.wordLength + 1, Semiring::zero());
+        powers.containsPrefixEqualsToSuffix.assign(powers.wordLength + 1, Semiring::zero());
+        powers.containsWordAsSubstring = Semiring::zero();
+        powers.containsEpsilon = Semiring::one();
+
+        powers.containsPrefixEqualsToSuffix = (powers * iteration).containsPrefixEqualsToSuffix;
+        BasicOperand started = iteration * powers;
+        powers.containsSuffixEqualsToPrefix.swap(started.containsSuffixEqualsToPrefix);
+        powers.containsWordAsSubstring = started.containsWordAsSubstring;
+        return powers;
+    }
+};
+
+struct OperandBenchmark;
+
+// Булево полукольцо -- исходный алгоритм: таблицы подслов хранятся списками или плотными
+// таблицами, а операнды до 256 символов Solver вычисляет строками-битсетами (FixedOperand)
+template <>
+struct BasicOperand<BooleanSemiring>;
+
+typedef BasicOperand<BooleanSemiring> Operand;
+
+template <>
+struct BasicOperand<BooleanSemiring> {
+    typedef BooleanSemiring::Value Value;
+
+private:
+    friend struct OperandBenchmark; // замеряет закрытые ядра умножения
+
+    bool sparse;
+    // таблица подслов хранится списком substrings (иначе -- плотной таблицей containsSubstring).
+    // Обычно верных ячеек немного (литерал встречается в слове несколько раз), и тогда операции
+    // над списками стоят порядка числа совпадений, а не n^2. Представление выбирается заново
+    // после каждой операции по доле верных ячеек (TuningConfig::operandSparseDensity)
+
+    OperandTable containsSubstring;
+    // containsSubstring[i][j] == true <=> подслово (данного слова) длины j,
+    // начинающееся в i-ой позиции, содержится в нашем языке L(Operand); пусто при sparse
+
+    OperandIntervals substrings;
+    // при sparse -- все подслова (i, j), для которых containsSubstring[i][j] == true,
+    // в порядке OperandInterval без повторов; пусто при !sparse
+
+    bool containsEpsilon;
+    // containsEpsilon == true <=> пустое слово принадлежит нашему языку L(Operand)
+
+    bool containsWordAsSubstring;
+    // containsWordAsSubstring == true <=> данное слово word содержится
+    // в качестве подслова какого-либо слова v из языка L(Operand)
+
+    OperandRow containsSuffixEqualsToPrefix;
+    // containsSuffixEqualsToPrefix[length] == true <=> есть в языке L(Operand) слово v, такое,
+    // что суффикс u слова v является префиксом длины length данного слова word
+
+    OperandRow containsPrefixEqualsToSuffix;
+    // containsPrefixEqualsToSuffix[length] == true <=> есть в языке L(Operand) cлово v, такое,
+    // что префикс u слова v является суффиксом длины length данного слова word
+
+    ulong wordLength;
+    // длина данного слова word
+
+    // Число ячеек таблицы, которые могут быть верны: подслова длины от 1
+    double cellCount() const {
+        return static_cast<double>(wordLength) * static_cast<double>(wordLength + 1) / 2;
+    }
+
+    void makeDense() {
+        containsSubstring = OperandTable(wordLength + 1, OperandRow(wordLength + 1, 0));
+        for (const OperandInterval &interval : substrings) {
+            containsSubstring[interval.start][interval.length] = true;
+        }
+        OperandIntervals().swap(substrings);
+        sparse = false;
+    }
+
+    void makeSparse() {
+        for (ulong startPosition = 0; startPosition < wordLength; ++startPosition) {
+            for (ulong length = 1; length <= wordLength - startPosition; ++length) {
+                if (containsSubstring[startPosition][length]) {
+                    substrings.push_back(OperandInterval{static_cast<unsigned>(startPosition),
+                                                         static_cast<unsigned>(length)});
+                }
+            }
+        }
+        OperandTable().swap(containsSubstring);
+        sparse = true;
+    }
+
+    // Разреженная таблица становится плотной, когда доля верных ячеек превышает порог, плотная
+    // разреженной -- когда доля меньше половины порога, чтобы операнд у порога не переключался
+    // туда и обратно
+    void adaptRepresentation() {
+        double threshold = TuningConfig::current().operandSparseDensity * cellCount();
+        if (sparse) {
+            if (static_cast<double>(substrings.size()) > threshold) {
+                makeDense();
+            }
+            return;
+        }
+
+        ulong count = 0;
+        for (ulong startPosition = 0; startPosition < wordLength; ++startPosition) {
+            for (ulong length = 1; length <= wordLength - startPosition; ++length) {
+                count += containsSubstring[startPosition][length] != 0;
+            }
+        }
+        if (2 * static_cast<double>(count) < threshold) {
+            makeSparse();
+        }
+    }
+
+    // Добавляет в таблицу подслова из упорядоченного списка без повторов
+    void uniteIntervals(const OperandIntervals &intervals) {
+        if (!sparse) {
+            for (const OperandInterval &interval : intervals) {
+                containsSubstring[interval.start][interval.length] = true;
+            }
+            return;
+        }
+        OperandIntervals merged;
+        merged.reserve(substrings.size() + intervals.size());
+        std::set_union(substrings.begin(), substrings.end(), intervals.begin(), intervals.end(),
+                       std::back_inserter(merged));
+        substrings.swap(merged);
+    }
+
+    // Таблица подслов объединения: к таблице добавляется таблица other
+    void uniteSubstrings(const Operand &other) {
+        if (other.sparse) {
+            uniteIntervals(other.substrings);
+            return;
+        }
+        if (sparse) {
+            makeDense();
+        }
+        for (ulong startPosition = 0; startPosition < wordLength; ++startPosition) {
+            for (ulong length = 0; length <= wordLength - startPosition; ++length) {
+                containsSubstring[startPosition][length] |= other.containsSubstring[startPosition][length];
+            }
+        }
+    }
+
+    void updateContainsWordAsSubstringForMultiply(Operand &result, const Operand &left, const Operand &right) const {
+        result.containsWordAsSubstring = left.containsWordAsSubstring || right.containsWordAsSubstring;
+
+        // L1 ~ left; L2 ~ right; L1.L2 ~ result
+
+        // word = CCCCCTTTT
+        //        ^^^^^      - prefix
+        //             ^^^^  - suffix
+
+        // L1: XXXXXCCCCC             L2: TTTTYYYYYY    ->   L1.L2:   XXXXXCCCCCTTTTYYYYYY
+        //          ^^^^^                 ^^^^                             ^^^^^^^^^
+        //       suffix equals        prefix equals             word contains as substring in new language
+        //         to prefix            to suffix
+
+        for (ulong prefixLength = 1; prefixLength < wordLength; ++prefixLength) {
+            ulong suffixLength = wordLength - prefixLength;
+            assert(suffixLength > 0 && suffixLength < wordLength);
+
+            result.containsWordAsSubstring |=
+                    left.containsSuffixEqualsToPrefix[prefixLength]
+                    && right.containsPrefixEqualsToSuffix[suffixLength];
+        }
+
+        // word == CCCCTTTTYYY
+        //         ^^^^^^^^    - prefix with prefixLength
+        //         ^^^^        - subPrefix with subPrefixLength
+        //             ^^^^    - suffixOfPrefix with suffixOfPrefixLength
+
+        // L1: XXCCCC  L2: TTTT            ->      L1.L2:  XXCCCCTTTT
+        //       ^^^^      ^^^^                              ^^^^^^^^
+        //    subPrefix   suffixOfPrefix               new suffix equals to prefix
+
+        for (ulong prefixLength = 1; prefixLength < wordLength; ++prefixLength) {
+            result.containsSuffixEqualsToPrefix[prefixLength] = right.containsSuffixEqualsToPrefix[prefixLength];
+            result.containsSuffixEqualsToPrefix[prefixLength] |=
+                    left.containsSuffixEqualsToPrefix[prefixLength] && right.containsEpsilon;
+            if (right.sparse) {
+                continue;
+            }
+
+            CancellationScope::checkpoint(prefixLength);
+            for (ulong subPrefixLength = 1; subPrefixLength < prefixLength; ++subPrefixLength) {
+                ulong suffixOfPrefixLength = prefixLength - subPrefixLength;
+
+                result.containsSuffixEqualsToPrefix[prefixLength] |=
+                        right.containsSubstring[subPrefixLength][suffixOfPrefixLength]
+                        && left.containsSuffixEqualsToPrefix[subPrefixLength];
+            }
+
+        }
+
+        // То же по списку: подслово right длины suffixOfPrefixLength с началом subPrefixLength
+        // продолжает префикс длины subPrefixLength
+        if (right.sparse) {
+            CancellationScope::checkpoint(right.substrings.size());
+            for (const OperandInterval &interval : right.substrings) {
+                ulong prefixLength = interval.start + interval.length;
+                if (interval.start > 0 && prefixLength < wordLength
+                    && left.containsSuffixEqualsToPrefix[interval.start]) {
+                    result.containsSuffixEqualsToPrefix[prefixLength] = true;
+                }
+            }
+        }
+
+        // word == YYYYCCCCCCTTTT
+        //             ^^^^^^^^^^  - suffix
+        //                   ^^^^  - subSuffix
+        //             ^^^^^^      - prefix of suffix
+
+        // L1: CCCCCC         L2: TTTTXXXX       ->    L1.L2:   CCCCCCTTTTXXXX
+        //     ^^^^^^             ^^^^                          ^^^^^^^^^^
+        //  prefix of suffix     subSuffix                   new prefix equals to suffix
+
+        for (ulong suffixLength = 1; suffixLength < wordLength; ++suffixLength) {
+            result.containsPrefixEqualsToSuffix[suffixLength] = left.containsPrefixEqualsToSuffix[suffixLength];
+            result.containsPrefixEqualsToSuffix[suffixLength] |=
+                    left.containsEpsilon && right.containsPrefixEqualsToSuffix[suffixLength];
+            if (left.sparse) {
+                continue;
+            }
+
+            CancellationScope::checkpoint(suffixLength);
+            for (ulong subSuffixLength = 1; subSuffixLength < suffixLength; ++subSuffixLength) {
+                ulong prefixOfSuffixLength = suffixLength - subSuffixLength;
+
+                result.containsPrefixEqualsToSuffix[suffixLength] |=
+                        left.containsSubstring[wordLength - suffixLength][prefixOfSuffixLength]
+                        && right.containsPrefixEqualsToSuffix[subSuffixLength];
+            }
+        }
+
+        // То же по списку: подслово left с началом wordLength - suffixLength, за которым
+        // остаётся суффикс длины subSuffixLength
+        if (left.sparse) {
+            CancellationScope::checkpoint(left.substrings.size());
+            for (const OperandInterval &interval : left.substrings) {
+                ulong end = interval.start + interval.length;
+                if (interval.start > 0 && end < wordLength
+                    && right.containsPrefixEqualsToSuffix[wordLength - end]) {
+                    result.containsPrefixEqualsToSuffix[wordLength - interval.start] = true;
+                }
+            }
+        }
+    }
+
+    // Оба списка: подслово left продолжается подсловом right, начинающимся сразу за ним
+    void multiplySparseBySparse(Operand &result, const Operand &left, const Operand &right) const {
+        OperandIntervals products;
+        for (const OperandInterval &prefix : left.substrings) {
+            OperandInterval next{prefix.start + prefix.length, 0};
+            for (auto suffix = std::lower_bound(right.substrings.begin(), right.substrings.end(), next);
+                 suffix != right.substrings.end() && suffix->start == next.start; ++suffix) {
+                products.push_back(OperandInterval{prefix.start, prefix.length + suffix->length});
+            }
+        }
+        CancellationScope::checkpoint(left.substrings.size() + products.size());
+        std::sort(products.begin(), products.end());
+        products.erase(std::unique(products.begin(), products.end()), products.end());
+        result.uniteIntervals(products);
+    }
+
+    // Список слева, таблица справа: к каждому подслову left приписываются строки right
+    void multiplySparseByDense(Operand &result, const Operand &left, const Operand &right) const {
+        for (const OperandInterval &prefix : left.substrings) {
+            ulong next = prefix.start + prefix.length;
+            if (next >= wordLength) {
+                continue;
+            }
+            CancellationScope::checkpoint(wordLength - next);
+            const OperandRow &suffixes = right.containsSubstring[next];
+            OperandRow &products = result.containsSubstring[prefix.start];
+            for (ulong suffixLength = 1; suffixLength <= wordLength - next; ++suffixLength) {
+                products[prefix.length + suffixLength] |= suffixes[suffixLength];
+            }
+        }
+    }
+
+    // Таблица слева, список справа: каждое подслово right продолжает подслова left,
+    // заканчивающиеся перед его началом
+    void multiplyDenseBySparse(Operand &result, const Operand &left, const Operand &right) const {
+        for (const OperandInterval &suffix : right.substrings) {
+            CancellationScope::checkpoint(suffix.start);
+            for (ulong startPosition = 0; startPosition < suffix.start; ++startPosition) {
+                if (left.containsSubstring[startPosition][suffix.start - startPosition]) {
+                    result.containsSubstring[startPosition][suffix.start - startPosition + suffix.length] = true;
+                }
+            }
+        }
+    }
+
+    void updateContainsSubstringForMultiply(Operand &result, const Operand &left, const Operand &right) const {
+        if (left.sparse || right.sparse) {
+            if (left.sparse && right.sparse) {
+                multiplySparseBySparse(result, left, right);
+            } else {
+                if (result.sparse) {
+                    result.makeDense();
+                }
+                if (left.sparse) {
+                    multiplySparseByDense(result, left, right);
+                } else {
+                    multiplyDenseBySparse(result, left, right);
+                }
+            }
+            if (left.containsEpsilon) {
+                result.uniteSubstrings(right);
+            }
+            if (right.containsEpsilon) {
+                result.uniteSubstrings(left);
+            }
+            result.containsEpsilon = left.containsEpsilon && right.containsEpsilon;
+            return;
+        }
+
+        if (result.sparse) {
+            result.makeDense();
+        }
+        for (ulong startPosition = 0; startPosition < wordLength; ++startPosition) {
+            ulong rowLength = wordLength - startPosition;
+            CancellationScope::checkpoint(rowLength * (rowLength + 3) / 2);
+            for (ulong length = 1; length <= wordLength - startPosition; ++length) {
+                for (ulong prefixLength = 0; prefixLength <= length; ++prefixLength) {
+
+                    ulong suffixLength = length - prefixLength;
+
+                    prefixLength++;
+                    prefixLength--;
+
+                    if (prefixLength == 0) {
+                        if (left.containsEpsilon) {
+                            result.containsSubstring[startPosition][length] |=
+                                    right.containsSubstring[startPosition][length];
+                        }
+                        continue;
+                    }
+
+                    if (suffixLength == 0) {
+                        if (right.containsEpsilon) {
+                            result.containsSubstring[startPosition][length] |=
+                                    left.containsSubstring[startPosition][length];
+                        }
+                        continue;
+                    }
+
+                    result.containsSubstring[startPosition][length] |=
+                            left.containsSubstring[startPosition][prefixLength] &&
+                            right.containsSubstring[startPosition + prefixLength][suffixLength];
+
+
+                    // Слово W длины length лежит в языке (L1 . L2), если найдется
+                    // такой префикс длины sublength слова W, что этот префикс
+                    // принадлежит языку L1, и при этом языку L2 принадлежит
+                    // суффикс длины (length - sublegth) слова W
+
+                }
+            }
+        }
+
+        result.containsEpsilon = left.containsEpsilon && right.containsEpsilon;
+    }
+
+public:
+
+    // Операнд, задающий язык из одного символа
+    BasicOperand(char character, string_view word) : sparse(true) {
+        containsPrefixEqualsToSuffix.clear();
+        containsPrefixEqualsToSuffix.resize(word.length() + 1);
+        containsSuffixEqualsToPrefix.clear();
+        containsSuffixEqualsToPrefix.resize(word.length() + 1);
+        wordLength = word.length();
+
+        if (character == EPSILON) {
+            containsEpsilon = true;
+            containsWordAsSubstring = false;
+        } else {
+            containsEpsilon = false;
+
+            if (word.length() == 1) {
+                containsWordAsSubstring = word[0] == character;
+            } else {
+                containsWordAsSubstring = false;
+            }
+
+            if (word[0] == character) {
+                containsSuffixEqualsToPrefix[1] = true;
+            }
+
+            if (word.back() == character) {
+                containsPrefixEqualsToSuffix[1] = true;
+            }
+
+            for (ulong startPosition = 0; startPosition < wordLength; ++startPosition) {
+                if (character == word[startPosition]) {
+                    substrings.push_back(OperandInterval{static_cast<unsigned>(startPosition), 1});
+                }
+            }
+        }
+        adaptRepresentation();
+    }
+
+    // Операнд, задающий язык из одного символа с весом weight: false -- пустой язык
+    BasicOperand(char character, string_view word, Value weight) :
+            BasicOperand(weight ? BasicOperand(character, word) : BasicOperand(word.length())) {}
+
+    // Операнд литерала w или w*, таблицы которого вычислены сопоставлением строк
+    BasicOperand(const LiteralTables &tables, ulong wordLength) :
+            sparse(true), substrings(tables.substrings), containsEpsilon(tables.containsEpsilon),
+            containsWordAsSubstring(tables.containsWordAsSubstring),
+            containsSuffixEqualsToPrefix(wordLength + 1), containsPrefixEqualsToSuffix(wordLength + 1),
+            wordLength(wordLength) {
+        for (ulong length : tables.suffixEqualsToPrefix) {
+            containsSuffixEqualsToPrefix[length] = true;
+        }
+        for (ulong length : tables.prefixEqualsToSuffix) {
+            containsPrefixEqualsToSuffix[length] = true;
+        }
+        adaptRepresentation();
+    }
+
+    // Операнд, задающий пустой язык
+    BasicOperand(ulong wordLength) : sparse(true), containsEpsilon(false), containsWordAsSubstring(false),
+                                containsSuffixEqualsToPrefix(wordLength + 1),
+                                containsPrefixEqualsToSuffix(wordLength + 1),
+                                wordLength(wordLength) {}
+
+    BasicOperand() : sparse(true) {}
+
+    bool isWordEqualToSomeSubstringInLanguage() const {
+        return containsWordAsSubstring;
+    }
+
+    // Тот же язык без пустого слова: итерация звёздочки
+    void removeEpsilon() {
+        containsEpsilon = false;
+    }
+
+    // Байты, занятые таблицами операнда
+    ulong byteSize() const {
+        ulong bytes = containsSubstring.capacity() * sizeof(OperandRow) + substrings.capacity() * sizeof(OperandInterval)
+                      + (containsSuffixEqualsToPrefix.capacity() + containsPrefixEqualsToSuffix.capacity()) * sizeof(int);
+        for (const OperandRow &row : containsSubstring) {
+            bytes += row.capacity() * sizeof(int);
+        }
+        return bytes;
+    }
+
+    Operand operator+(const Operand &right) const {
+        Operand left = *this;
+
+        left.uniteSubstrings(right);
+
+        for (ulong length = 1; length <= wordLength; ++length) {
+            left.containsSuffixEqualsToPrefix[length] |= right.containsSuffixEqualsToPrefix[length];
+            left.containsPrefixEqualsToSuffix[length] |= right.containsPrefixEqualsToSuffix[length];
+        }
+
+        left.containsEpsilon |= right.containsEpsilon;
+        left.containsWordAsSubstring |= right.containsWordAsSubstring;
+
+        assert(left.wordLength == right.wordLength);
+
+        left.adaptRepresentation();
+        return left;
+    }
+
+    Operand operator*(const Operand &right) const {
+        Operand left = *this;
+        Operand result(wordLength);
+
+        updateContainsSubstringForMultiply(result, left, right);
+
+        updateContainsWordAsSubstringForMultiply(result, left, right);
+
+        result.adaptRepresentation();
+        return result;
+    }
+
+};
+
+// Значение выражения над полукольцом Semiring; Expression -- над булевым
+template <typename Semiring>
+struct BasicExpression {
+    typedef BasicOperand<Semiring> Operand;
+    typedef typename Semiring::Value Value;
+
+private:
+    friend struct OperandBenchmark; // замеряет calculateKleeneStar
+    static constexpr bool boolean = std::is_same<Semiring, BooleanSemiring>::value;
+
+    std::stack<Operand> operands;
+    string_view expression;
+    ulong starIterations; // итерации звёздочки Клини, выполненные этим выражением
+    std::shared_ptr<const LiteralSpans> literalSpans; // общие для копий выражения
+    std::vector<Value> leafWeights; // веса листьев по порядку записи; пусто -- каждый лист весит one
+    ulong leafIndex;
+
+#ifdef FORMAL_LANGUAGE_OPERATOR_TRACE
+    std::vector<ulong> subexpressionStarts;
+    // subexpressionStarts[k] -- позиция в записи, с которой начинается подвыражение k-го операнда стека
+
+    // Срез записи с подвыражением, которое образует оператор в позиции position
+    string_view operatorSlice(OperatorType currentOperator, ulong position) {
+        ulong arity = currentOperator == KLEENE_STAR ? 1 : 2;
+        if (subexpressionStarts.size() < arity) {
+            return expression.substr(position, 1); // об ошибке сообщит calculateOperator
+        }
+        subexpressionStarts.resize(subexpressionStarts.size() - arity + 1);
+        return expression.substr(subexpressionStarts.back(), position - subexpressionStarts.back() + 1);
+    }
+
+    static const char *operatorName(OperatorType currentOperator) {
+        switch (currentOperator) {
+            case PLUS:
+                return "union";
+            case MULTIPLY:
+                return "concatenation";
+            default:
+                return "star";
+        }
+    }
+#endif
+
+    bool isOperator(char character) const {
+        std::set<char> allOperators({'+', '.', '*'});
+        return allOperators.count(character) == 1;
+    }
+
+    bool isSymbolOfAlphabet(char character) const {
+        std::set<char> allSymbols({'a', 'b', 'c', EPSILON});
+        return allSymbols.count(character) == 1;
+    }
+
+    void checkWord(string_view word) const {
+        ProfilePhaseScope phase(PHASE_PARSE);
+        validateWord(word);
+    }
+
+    // Литералы вычисляются сопоставлением строк только в булевом полукольце и без весов
+    // листьев: у листьев литерала свои веса
+    std::shared_ptr<const LiteralSpans> findSpans() const {
+        return findLiteralSpans(boolean && leafWeights.empty() ? expression : string_view());
+    }
+
+    void pushLiteral(const LiteralSpan &span, string_view word) {
+        if constexpr (boolean) {
+            operands.push(Operand(LiteralTables(span, word), word.length()));
+        }
+    }
+
+    void pushLeaf(char character, string_view word) {
+        if (leafWeights.empty()) {
+            operands.push(Operand(character, word));
+            return;
+        }
+        if (leafIndex >= leafWeights.size()) {
+            throw ParseException("Too few leaf weights for the expression");
+        }
+        operands.push(Operand(character, word, leafWeights[leafIndex++]));
+    }
+
+    OperatorType operatorCode(char character) const {
+        switch (character) {
+            case '+':
+                return PLUS;
+            case '.':
+                return MULTIPLY;
+            case '*':
+                return KLEENE_STAR;
+            default:
+                string message = "Unknown operator symbol: " + string(1, character);
+                throw ParseException(message);
+        }
+    }
+
+    void calculateOperator(string_view word, OperatorType currentOperator) {
+        // Calculate PLUS or MULTIPLY or KLEENE STAR
+        if (currentOperator == KLEENE_STAR) {
+            calculateKleeneStar(word);
+            return;
+        }
+
+        // Calculate PLUS or MULTIPLY
+        if (operands.size() < 2) {
+            throw ParseException("Missing operands");
+        }
+
+        Operand right = operands.top();
+        operands.pop();
+        Operand left = operands.top();
+        operands.pop();
+
+        operands.push(currentOperator == PLUS ? left + right : left * right);
+    }
+
+    void calculateKleeneStar(string_view word) {
+        if (operands.size() < 1) {
+            throw ParseException("Missing operands");
+        }
+
+        // e* = e^0 + e^1 + e^2 ... e^n + e^(n+1) ..., где e -- язык операнда без пустого слова:
+        // тогда каждый вывод подслова проходит через не больше n итераций, и у весов он учтён
+        // один раз
+
+        // n == 0:
+        Operand currentPow(EPSILON, word); // Операнд, задающий язык из пустого слова
+        Operand startOperand = operands.top(); // startOperand := e
+        operands.pop();
+        startOperand.removeEpsilon();
+        Operand currentOperand = currentPow; // e^0 -- язык из пустого слова
+
+        // n > 0 && n < 2 * length + 2:
+        OPERATOR_TRACE_ITERATIONS(2 * word.length() + 2);
+        starIterations += 2 * word.length() + 2;
+        for (ulong i = 0; i < 2 * word.length() + 2; ++i) {
+            CancellationScope::checkpoint(1);
+            Operand nextPow = currentPow * startOperand; // nextPow := e^n * e
+            Operand nextOperand = currentOperand + nextPow; // nextOperand := e^n + e^(n+1)
+            currentPow = nextPow;
+            currentOperand = nextOperand;
+        }
+
+        // В булевом полукольце plus идемпотентен, и суммы степеней уже верны
+        if constexpr (!boolean) {
+            currentOperand = Operand::completeStar(startOperand, currentOperand);
+        }
+        operands.push(currentOperand);
+    }
+
+public:
+
+    BasicExpression() : starIterations(0), literalSpans(findLiteralSpans("")), leafIndex(0) {}
+
+    // Выражение не копируется: expression должно жить дольше объекта. leafWeights -- веса
+    // листьев (букв и '1') по порядку записи; без них каждый лист весит one
+    explicit BasicExpression(string_view expression, const std::vector<Value> &leafWeights = {}) :
+            expression(expression), starIterations(0), leafWeights(leafWeights), leafIndex(0) {
+        literalSpans = findSpans();
+    }
+
+    // Выражение не копируется: expression указывает внутрь входного буфера
+    void readExpression(MappedInput &input) {
+        ProfilePhaseScope phase(PHASE_PARSE);
+        expression = input.nextToken();
+
+        if (expression.empty()) {
+            throw ParseException("Expression is empty");
+        }
+        literalSpans = findSpans();
+    }
+
+    // Подвыражения-литералы, таблицы которых вычисляются сопоставлением строк
+    const LiteralSpans &getLiteralSpans() const {
+        return *literalSpans;
+    }
+
+    string_view getExpression() const {
+        return expression;
+    }
+
+    ulong getStarIterations() const {
+        return starIterations;
+    }
+
+    Operand calculateValueOfExpression(string_view word) {
+        checkWord(word);
+        OPERATOR_TRACE_SCOPE("expression", expression, word.length());
+
+        // В сборке с трассировкой операторов литералы вычисляются как обычно, чтобы трасса
+        // описывала каждый оператор
+        LiteralSpans::const_iterator span = literalSpans->begin();
+#ifdef FORMAL_LANGUAGE_OPERATOR_TRACE
+        span = literalSpans->end();
+#endif
+        leafIndex = 0;
+        for (ulong i = 0; i < expression.length(); ++i) {
+            if (span != literalSpans->end() && span->begin == i) {
+                ProfilePhaseScope phase(PHASE_LEAF);
+                pushLiteral(*span, word);
+                i = span->end - 1;
+                ++span;
+            } else if (isOperator(expression[i])) {
+                OperatorType currentOperator = operatorCode(expression[i]);
+                OPERATOR_TRACE_SCOPE(operatorName(currentOperator), operatorSlice(currentOperator, i), word.length());
+                ProfilePhaseScope phase(currentOperator == PLUS ? PHASE_UNION
+                                        : currentOperator == MULTIPLY ? PHASE_CONCATENATION : PHASE_STAR);
+                calculateOperator(word, currentOperator);
+                OPERATOR_TRACE_RESULT_BYTES(operands.top().byteSize());
+            } else if (isSymbolOfAlphabet(expression[i])) {
+#ifdef FORMAL_LANGUAGE_OPERATOR_TRACE
+                subexpressionStarts.push_back(i);
+#endif
+                ProfilePhaseScope phase(PHASE_LEAF);
+                pushLeaf(expression[i], word);
+            } else {
+                string message = "Unknown symbol in expression: " + string(1, expression[i]);
+                throw ParseException(message);
+            }
+        }
+
+        ProfilePhaseScope phase(PHASE_ANSWER);
+        if (operands.size() > 1) {
+            throw ParseException("Too much operands");
+        }
+        if (operands.size() < 1) {
+            throw ParseException("Missing operands");
+        }
+        if (leafIndex < leafWeights.size()) {
+            throw ParseException("Too many leaf weights for the expression");
+        }
+        return operands.top();
+    }
+
+};
+
+typedef BasicExpression<BooleanSemiring> Expression;
+
+// Ответ запроса с ограничениями: при partial == true length -- лучшая нижняя граница,
+// доказанная до истечения срока или бюджета
+struct PartialAnswer {
+    ulong length;
+    bool partial;
+};
+
+struct Solver {
+private:
+    Expression expression;
+    string_view word;
+    OperandMemory::Statistics memory;
+    ulong starIterations;
+    FixedEvaluator<64> shortEvaluator;
+    FixedEvaluator<128> mediumEvaluator;
+    FixedEvaluator<256> longEvaluator;
+
+public:
+    Solver(const Expression &expression, string_view word) :
+            expression(expression), word(word), memory{0, 0, 0}, starIterations(0) {}
+
+    Solver() : memory{0, 0, 0}, starIterations(0) {}
+
+    // Если таблицам операндов понадобится больше memoryLimit байт (0 -- без ограничения),
+    // бросается MemoryLimitException
+    ulong solve(ulong memoryLimit = 0) {
+        return solveWithin(EvaluationBudget(), memoryLimit).length;
+    }
+
+    // Вычисление со сроком или бюджетом работы: по их истечении возвращается наибольшая
+    // длина, для которой подходящее подслово уже найдено, с признаком partial
+    PartialAnswer solveWithin(const EvaluationBudget &budget, ulong memoryLimit = 0) {
+        OperandMemory::resetPeak();
+        OperandMemory::Statistics before = OperandMemory::getStatistics();
+        OperandMemory::setLimit(memoryLimit == 0 ? 0 : before.liveBytes + memoryLimit);
+        PartialAnswer answer{0, false};
+        try {
+            CancellationScope cancellation(budget);
+            solveAllSubstrings(answer.length);
+        } catch (DeadlineExceededException e) {
+            answer.partial = true;
+        } catch (...) {
+            recordMemory(before);
+            throw;
+        }
+        recordMemory(before);
+        return answer;
+    }
+
+    // Память таблиц последнего вызова solve: максимум одновременно живых байт
+    // (сверх живших до вызова) и сумма выделенных байт
+    const OperandMemory::Statistics &getMemoryStatistics() const {
+        return memory;
+    }
+
+    // Итерации звёздочки Клини за последний вызов solve
+    ulong getStarIterations() const {
+        return starIterations;
+    }
+
+private:
+    void recordMemory(const OperandMemory::Statistics &before) {
+        OperandMemory::setLimit(0);
+        OperandMemory::Statistics after = OperandMemory::getStatistics();
+        memory = OperandMemory::Statistics{after.liveBytes - before.liveBytes,
+                                           after.peakLiveBytes - before.liveBytes,
+                                           after.allocatedBytes - before.allocatedBytes};
+    }
+
+    // Подслова перебираются по возрастанию длины, и answer всё время равен наибольшей длине,
+    // для которой подходящее подслово уже найдено. Подслова слов языка образуют множество,
+    // замкнутое относительно взятия подслова, поэтому если ни одно подслово длины length
+    // не подошло, длиннее тоже не подойдут и перебор заканчивается
+    void solveAllSubstrings(ulong &answer) {
+        starIterations = 0;
+        if (!word.empty()) {
+            validateWord(word);
+        }
+
+        for (ulong length = 1; length <= word.length(); ++length) {
+            bool found = false;
+
+            for (ulong startPosition = 0; startPosition + length <= word.length() && !found; ++startPosition) {
+                found = isFactor(word.substr(startPosition, length));
+            }
+
+            if (!found) {
+                break;
+            }
+            answer = length;
+        }
+    }
+
+    // Является ли toCheck подсловом слова языка. Подслова до 256 символов вычисляются операндами
+    // наименьшей подходящей фиксированной ёмкости; в сборке с трассировкой операторов всегда
+    // используется Operand, чтобы трасса описывала все вычисления
+    bool isFactor(string_view toCheck) {
+#ifndef FORMAL_LANGUAGE_OPERATOR_TRACE
+        if (toCheck.length() <= 64) {
+            return shortEvaluator.containsWordAsSubstring(expression.getExpression(), expression.getLiteralSpans(),
+                                                          toCheck, starIterations);
+        }
+        if (toCheck.length() <= 128) {
+            return mediumEvaluator.containsWordAsSubstring(expression.getExpression(), expression.getLiteralSpans(),
+                                                           toCheck, starIterations);
+        }
+        if (toCheck.length() <= 256) {
+            return longEvaluator.containsWordAsSubstring(expression.getExpression(), expression.getLiteralSpans(),
+                                                         toCheck, starIterations);
+        }
+#endif
+        Expression bufferExpression = expression;
+        Operand result = bufferExpression.calculateValueOfExpression(toCheck);
+        starIterations += bufferExpression.getStarIterations();
+
+        ProfilePhaseScope phase(PHASE_ANSWER);
+        return result.isWordEqualToSomeSubstringInLanguage();
+    }
+};
+
+#endif // FORMAL_LANGUAGE_OPERAND_H
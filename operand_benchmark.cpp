@@ -0,0 +1,298 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <new>
+#include <random>
+#include <string>
+#include <vector>
+#include <sys/resource.h>
+
+#include "operand.h"
+
+// Микробенчмарки ядер Operand: построение листа, operator+, operator*, его части
+// updateContainsSubstringForMultiply и updateContainsWordAsSubstringForMultiply по отдельности
+// и calculateKleeneStar. Длина слова перебирается степенями двойки, операнды бывают плотные,
+// разреженные и с пустым словом. Для каждого случая печатаются ns/op, выделенная за операцию
+// память и пиковый RSS:
+// operand_benchmark [--min-length N] [--max-length N] [--time-budget S] [--memory-limit B] [--json]
+
+namespace {
+
+std::atomic<ulong> allocatedBytes(0);
+
+void *countedAllocate(size_t size) {
+    allocatedBytes.fetch_add(size, std::memory_order_relaxed);
+    void *pointer = std::malloc(size == 0 ? 1 : size);
+    if (pointer == nullptr) {
+        throw std::bad_alloc();
+    }
+    return pointer;
+}
+
+} // namespace
+
+void *operator new(size_t size) {
+    return countedAllocate(size);
+}
+
+void *operator new[](size_t size) {
+    return countedAllocate(size);
+}
+
+void operator delete(void *pointer) noexcept {
+    std::free(pointer);
+}
+
+void operator delete[](void *pointer) noexcept {
+    std::free(pointer);
+}
+
+void operator delete(void *pointer, size_t) noexcept {
+    std::free(pointer);
+}
+
+void operator delete[](void *pointer, size_t) noexcept {
+    std::free(pointer);
+}
+
+enum OperandShape {
+    DENSE,         // около половины таблиц заполнено
+    SPARSE,        // несколько вхождений на всё слово, как у литерала
+    EPSILON_HEAVY  // разреженные таблицы, но пустое слово в языке: работают ветви с containsEpsilon
+};
+
+const char *shapeName(OperandShape shape) {
+    switch (shape) {
+        case DENSE:
+            return "dense";
+        case SPARSE:
+            return "sparse";
+        default:
+            return "epsilon_heavy";
+    }
+}
+
+// Доступ к закрытым ядрам Operand и Expression (объявлен другом в operand.h)
+struct OperandBenchmark {
+    static Operand makeOperand(ulong length, OperandShape shape, std::mt19937 &generator) {
+        Operand operand(length);
+        std::uniform_real_distribution<double> uniform(0.0, 1.0);
+        double density = shape == DENSE ? 0.5 : 4.0 / static_cast<double>(length * length);
+
+        operand.makeDense();
+        for (ulong start = 0; start < length; ++start) {
+            for (ulong substringLength = 1; substringLength <= length - start; ++substringLength) {
+                operand.containsSubstring[start][substringLength] = uniform(generator) < density;
+            }
+        }
+        for (ulong prefixLength = 1; prefixLength < length; ++prefixLength) {
+            operand.containsSuffixEqualsToPrefix[prefixLength] = uniform(generator) < max(density, 0.1);
+            operand.containsPrefixEqualsToSuffix[prefixLength] = uniform(generator) < max(density, 0.1);
+        }
+        operand.containsEpsilon = shape == EPSILON_HEAVY;
+        operand.adaptRepresentation(); // разреженные формы хранятся списком, как в Expression
+        return operand;
+    }
+
+    static void multiplySubstring(const Operand &left, const Operand &right, Operand &result) {
+        left.updateContainsSubstringForMultiply(result, left, right);
+    }
+
+    static void multiplyWord(const Operand &left, const Operand &right, Operand &result) {
+        left.updateContainsWordAsSubstringForMultiply(result, left, right);
+    }
+
+    static Operand kleeneStar(const Operand &operand, string_view word) {
+        Expression expression;
+        expression.operands.push(operand);
+        expression.calculateKleeneStar(word);
+        return expression.operands.top();
+    }
+};
+
+namespace {
+
+struct Kernel {
+    string name;
+    double exponent;       // степень роста времени по длине слова
+    ulong liveOperands;    // сколько таблиц n x n одновременно живёт во время операции
+    std::function<void(const Operand &, const Operand &, Operand &, string_view)> run;
+};
+
+struct Measurement {
+    string kernel;
+    string shape;
+    ulong length;
+    ulong iterations;
+    double nanosecondsPerOperation;
+    double bytesPerOperation;
+    ulong peakRssBytes;
+    bool skipped;
+};
+
+// Сбрасывает пиковый RSS процесса (Linux >= 4.0); false, если не удалось
+bool resetPeakRss() {
+    std::ofstream clearRefs("/proc/self/clear_refs");
+    clearRefs << "5";
+    return static_cast<bool>(clearRefs);
+}
+
+ulong peakRssBytes() {
+    std::ifstream status("/proc/self/status");
+    string line;
+    while (std::getline(status, line)) {
+        if (line.compare(0, 6, "VmHWM:") == 0) {
+            return std::strtoul(line.c_str() + 6, nullptr, 10) * 1024;
+        }
+    }
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return static_cast<ulong>(usage.ru_maxrss) * 1024;
+}
+
+Measurement measure(const Kernel &kernel, OperandShape shape, ulong length, double minSeconds) {
+    std::mt19937 generator(static_cast<unsigned>(length * 31 + shape));
+    string word(length, 'a');
+    for (char &character : word) {
+        character = static_cast<char>('a' + generator() % 3);
+    }
+    Operand left = OperandBenchmark::makeOperand(length, shape, generator);
+    Operand right = OperandBenchmark::makeOperand(length, shape, generator);
+    Operand result(length);
+
+    resetPeakRss();
+    ulong bytesBefore = allocatedBytes.load();
+    ulong iterations = 0;
+    auto start = std::chrono::steady_clock::now();
+    double elapsed = 0;
+
+    while (iterations == 0 || elapsed < minSeconds) {
+        kernel.run(left, right, result, word);
+        ++iterations;
+        elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    return Measurement{kernel.name, shapeName(shape), length, iterations, elapsed * 1e9 / iterations,
+                       static_cast<double>(allocatedBytes.load() - bytesBefore) / iterations, peakRssBytes(), false};
+}
+
+void printJson(const std::vector<Measurement> &measurements) {
+    cout << "{\"benchmarks\": [\n";
+    for (ulong i = 0; i < measurements.size(); ++i) {
+        const Measurement &measurement = measurements[i];
+        cout << "  {\"kernel\": \"" << measurement.kernel << "\", \"shape\": \"" << measurement.shape
+             << "\", \"length\": " << measurement.length << ", \"skipped\": "
+             << (measurement.skipped ? "true" : "false");
+        if (!measurement.skipped) {
+            cout << ", \"iterations\": " << measurement.iterations
+                 << ", \"ns_per_op\": " << measurement.nanosecondsPerOperation
+                 << ", \"bytes_allocated_per_op\": " << measurement.bytesPerOperation
+                 << ", \"peak_rss_bytes\": " << measurement.peakRssBytes;
+        }
+        cout << "}" << (i + 1 < measurements.size() ? "," : "") << "\n";
+    }
+    cout << "]}" << endl;
+}
+
+void printTable(const Measurement &measurement) {
+    std::printf("%-20s %-14s %6lu ", measurement.kernel.c_str(), measurement.shape.c_str(), measurement.length);
+    if (measurement.skipped) {
+        std::printf("%16s\n", "skipped");
+    } else {
+        std::printf("%16.0f ns/op %14.0f B/op %12lu peak RSS\n", measurement.nanosecondsPerOperation,
+                    measurement.bytesPerOperation, measurement.peakRssBytes);
+    }
+    std::fflush(stdout);
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    ulong minLength = 16;
+    ulong maxLength = 8192;
+    double timeBudget = 10.0;          // секунд на один случай; более долгие пропускаются
+    ulong memoryLimit = 2UL << 30;     // байт таблиц на один случай
+    double minSeconds = 0.05;
+    bool json = false;
+
+    for (int i = 1; i < argc; ++i) {
+        string argument = argv[i];
+        if (argument == "--min-length" && i + 1 < argc) {
+            minLength = std::strtoul(argv[++i], nullptr, 10);
+        } else if (argument == "--max-length" && i + 1 < argc) {
+            maxLength = std::strtoul(argv[++i], nullptr, 10);
+        } else if (argument == "--time-budget" && i + 1 < argc) {
+            timeBudget = std::atof(argv[++i]);
+        } else if (argument == "--memory-limit" && i + 1 < argc) {
+            memoryLimit = std::strtoul(argv[++i], nullptr, 10);
+        } else if (argument == "--json") {
+            json = true;
+        } else {
+            std::cerr << "Unknown argument: " << argument << endl;
+            return 1;
+        }
+    }
+
+    std::vector<Kernel> kernels = {
+            {"leaf", 2, 1, [](const Operand &, const Operand &, Operand &, string_view word) {
+                Operand leaf(word[0], word);
+            }},
+            {"plus", 2, 3, [](const Operand &left, const Operand &right, Operand &, string_view) {
+                Operand sum = left + right;
+            }},
+            {"multiply", 3, 4, [](const Operand &left, const Operand &right, Operand &, string_view) {
+                Operand product = left * right;
+            }},
+            {"multiply_substring", 3, 3, [](const Operand &left, const Operand &right, Operand &result, string_view) {
+                OperandBenchmark::multiplySubstring(left, right, result);
+            }},
+            {"multiply_word", 2, 3, [](const Operand &left, const Operand &right, Operand &result, string_view) {
+                OperandBenchmark::multiplyWord(left, right, result);
+            }},
+            {"kleene_star", 4, 8, [](const Operand &left, const Operand &, Operand &, string_view word) {
+                Operand closure = OperandBenchmark::kleeneStar(left, word);
+            }},
+    };
+
+    std::vector<Measurement> measurements;
+
+    for (const Kernel &kernel : kernels) {
+        for (OperandShape shape : {DENSE, SPARSE, EPSILON_HEAVY}) {
+            double previousSeconds = 0;
+            ulong previousLength = 0;
+
+            for (ulong length = minLength; length <= maxLength; length *= 2) {
+                double tableBytes = static_cast<double>(length + 1) * (length + 1) * sizeof(int);
+                double predictedSeconds = previousLength == 0 ? 0 : previousSeconds
+                        * std::pow(static_cast<double>(length) / previousLength, kernel.exponent);
+                bool skipped = predictedSeconds > timeBudget || tableBytes * kernel.liveOperands > memoryLimit
+                               || previousSeconds < 0;
+
+                Measurement measurement{kernel.name, shapeName(shape), length, 0, 0, 0, 0, true};
+                if (!skipped) {
+                    measurement = measure(kernel, shape, length, minSeconds);
+                    previousSeconds = measurement.nanosecondsPerOperation * 1e-9;
+                    previousLength = length;
+                } else {
+                    previousSeconds = -1; // большие длины тоже не поместятся
+                }
+
+                measurements.push_back(measurement);
+                if (!json) {
+                    printTable(measurement);
+                }
+            }
+        }
+    }
+
+    if (json) {
+        printJson(measurements);
+    }
+    return 0;
+}
@@ -0,0 +1,118 @@
+#ifndef FORMAL_LANGUAGE_OPERAND_MEMORY_H
+#define FORMAL_LANGUAGE_OPERAND_MEMORY_H
+
+// Учёт памяти таблиц Operand. Все таблицы выделяются через OperandAllocator, который ведёт
+// в текущем потоке счётчики живых байт, их максимума и всех выделенных байт, поэтому в учёт
+// попадают и операнды на стеке выражения, и временные операнды звёздочки Клини. Если задан
+// предел, выделение сверх него бросает MemoryLimitException вместо того, чтобы процесс
+// исчерпал память
+
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+#include "common.h"
+
+struct MemoryLimitException : public std::runtime_error {
+    MemoryLimitException(const string &message) : std::runtime_error(message) {}
+};
+
+struct OperandMemory {
+public:
+    struct Statistics {
+        ulong liveBytes;
+        ulong peakLiveBytes;
+        ulong allocatedBytes; // с запуска потока
+    };
+
+private:
+    struct State {
+        ulong liveBytes;
+        ulong peakLiveBytes;
+        ulong allocatedBytes;
+        ulong limit; // 0 -- без ограничения
+    };
+
+    static State &state() {
+        static thread_local State current{0, 0, 0, 0};
+        return current;
+    }
+
+public:
+    static void allocate(ulong bytes) {
+        State &current = state();
+        if (current.limit != 0 && current.liveBytes + bytes > current.limit) {
+            throw MemoryLimitException("Operand tables need more than " + std::to_string(current.limit)
+                                       + " bytes");
+        }
+        current.liveBytes += bytes;
+        current.allocatedBytes += bytes;
+        current.peakLiveBytes = max(current.peakLiveBytes, current.liveBytes);
+    }
+
+    static void release(ulong bytes) {
+        State &current = state();
+        current.liveBytes -= std::min(bytes, current.liveBytes);
+    }
+
+    // Предел живых байт таблиц в текущем потоке; 0 снимает ограничение
+    static void setLimit(ulong bytes) {
+        state().limit = bytes;
+    }
+
+    // Начинает новый запрос: максимум живых байт отсчитывается от текущего значения
+    static void resetPeak() {
+        State &current = state();
+        current.peakLiveBytes = current.liveBytes;
+    }
+
+    static Statistics getStatistics() {
+        const State &current = state();
+        return Statistics{current.liveBytes, current.peakLiveBytes, current.allocatedBytes};
+    }
+};
+
+// Аллокатор таблиц Operand, ведущий учёт в OperandMemory
+template <typename T>
+struct OperandAllocator : public std::allocator<T> {
+    template <typename U>
+    struct rebind {
+        typedef OperandAllocator<U> other;
+    };
+
+    OperandAllocator() {}
+
+    template <typename U>
+    OperandAllocator(const OperandAllocator<U> &) {}
+
+    T *allocate(size_t count) {
+        OperandMemory::allocate(count * sizeof(T));
+        return std::allocator<T>::allocate(count);
+    }
+
+    void deallocate(T *pointer, size_t count) {
+        OperandMemory::release(count * sizeof(T));
+        std::allocator<T>::deallocate(pointer, count);
+    }
+};
+
+typedef std::vector<int, OperandAllocator<int> > OperandRow;
+typedef std::vector<OperandRow, OperandAllocator<OperandRow> > OperandTable;
+
+// Подслово данного слова: начало и длина. Упорядочены по началу, затем по длине
+struct OperandInterval {
+    unsigned start;
+    unsigned length;
+
+    bool operator<(const OperandInterval &other) const {
+        return start < other.start || (start == other.start && length < other.length);
+    }
+
+    bool operator==(const OperandInterval &other) const {
+        return start == other.start && length == other.length;
+    }
+};
+
+typedef std::vector<OperandInterval, OperandAllocator<OperandInterval> > OperandIntervals;
+
+#endif // FORMAL_LANGUAGE_OPERAND_MEMORY_H
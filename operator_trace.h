@@ -0,0 +1,177 @@
+#ifndef FORMAL_LANGUAGE_OPERATOR_TRACE_H
+#define FORMAL_LANGUAGE_OPERATOR_TRACE_H
+
+// Трассировка применений операторов в Expression::calculateValueOfExpression.
+// Включается макросом FORMAL_LANGUAGE_OPERATOR_TRACE (опция CMake того же имени); без него
+// макросы трассировки пусты. С ним каждое применение '+', '.' и '*' записывает интервал:
+// оператор, срез обратной польской записи подвыражения, длину слова, время, выделенную за
+// интервал память таблиц и размер таблиц результата, у '*' -- ещё число итераций. Интервалы
+// выгружаются в формате Chrome trace-event JSON (chrome://tracing, Perfetto)
+
+#include "common.h"
+#include "operand_memory.h"
+
+#ifdef FORMAL_LANGUAGE_OPERATOR_TRACE
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <ostream>
+#include <thread>
+#include <vector>
+
+struct OperatorTrace {
+public:
+    struct Span {
+        const char *name;
+        string rpn;
+        ulong wordLength;
+        double startMicroseconds;
+        double durationMicroseconds;
+        ulong allocatedBytes;
+        ulong resultBytes;
+        ulong iterations;
+        ulong threadId;
+    };
+
+    // Интервал на время жизни объекта
+    struct Scope {
+    private:
+        Span span;
+        ulong allocatedBefore;
+        Scope *parent;
+        std::chrono::steady_clock::time_point start;
+
+    public:
+        Scope(const char *name, string_view rpn, ulong wordLength) :
+                span{name, string(rpn), wordLength, 0, 0, 0, 0, 0, 0}, allocatedBefore(OperandMemory::getStatistics().allocatedBytes),
+                parent(currentScope()), start(std::chrono::steady_clock::now()) {
+            currentScope() = this;
+        }
+
+        Scope(const Scope &) = delete;
+        Scope &operator=(const Scope &) = delete;
+
+        ~Scope() {
+            auto end = std::chrono::steady_clock::now();
+            span.startMicroseconds = std::chrono::duration<double, std::micro>(start - origin).count();
+            span.durationMicroseconds = std::chrono::duration<double, std::micro>(end - start).count();
+            span.allocatedBytes = OperandMemory::getStatistics().allocatedBytes - allocatedBefore;
+            span.threadId = threadId();
+            currentScope() = parent;
+            instance().add(std::move(span));
+        }
+
+        void setIterations(ulong iterations) {
+            span.iterations = iterations;
+        }
+
+        void setResultBytes(ulong bytes) {
+            span.resultBytes = bytes;
+        }
+    };
+
+private:
+    std::vector<Span> spans;
+    ulong limit;
+    ulong dropped;
+    std::mutex mutex;
+
+    OperatorTrace() : limit(DEFAULT_LIMIT), dropped(0) {}
+
+    // Начало отсчёта поля ts: запуск программы
+    static inline const std::chrono::steady_clock::time_point origin = std::chrono::steady_clock::now();
+
+    // Короткий номер потока для поля tid
+    static ulong threadId() {
+        static std::atomic<ulong> nextId(1);
+        static thread_local ulong id = nextId.fetch_add(1);
+        return id;
+    }
+
+    static Scope *&currentScope() {
+        static thread_local Scope *scope = nullptr;
+        return scope;
+    }
+
+    void add(Span span) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (spans.size() < limit) {
+            spans.push_back(std::move(span));
+        } else {
+            ++dropped;
+        }
+    }
+
+    static void writeEscaped(std::ostream &output, string_view text) {
+        for (char character : text) {
+            if (character == '"' || character == '\\') {
+                output << '\\';
+            }
+            output << character;
+        }
+    }
+
+public:
+    // Перебор подслов в Solver даёт O(n^2) вычислений выражения; сверх лимита интервалы
+    // не сохраняются, а только считаются
+    static const ulong DEFAULT_LIMIT = 1 << 20;
+
+    static OperatorTrace &instance() {
+        static OperatorTrace trace;
+        return trace;
+    }
+
+    // Число итераций у самого вложенного открытого интервала текущего потока
+    static void setIterations(ulong iterations) {
+        if (currentScope() != nullptr) {
+            currentScope()->setIterations(iterations);
+        }
+    }
+
+    // Размер таблиц результата самого вложенного открытого интервала текущего потока
+    static void setResultBytes(ulong bytes) {
+        if (currentScope() != nullptr) {
+            currentScope()->setResultBytes(bytes);
+        }
+    }
+
+    void setLimit(ulong spanLimit) {
+        std::lock_guard<std::mutex> lock(mutex);
+        limit = spanLimit;
+    }
+
+    void writeChromeJson(std::ostream &output) {
+        std::lock_guard<std::mutex> lock(mutex);
+        output << "{\"displayTimeUnit\": \"ns\", \"otherData\": {\"dropped_spans\": " << dropped
+               << "}, \"traceEvents\": [\n";
+        for (ulong i = 0; i < spans.size(); ++i) {
+            const Span &span = spans[i];
+            output << "{\"name\": \"" << span.name << "\", \"cat\": \"operator\", \"ph\": \"X\", \"ts\": "
+                   << span.startMicroseconds << ", \"dur\": " << span.durationMicroseconds
+                   << ", \"pid\": 1, \"tid\": " << span.threadId << ", \"args\": {\"rpn\": \"";
+            writeEscaped(output, span.rpn);
+            output << "\", \"word_length\": " << span.wordLength << ", \"bytes_allocated\": "
+                   << span.allocatedBytes << ", \"result_bytes\": " << span.resultBytes;
+            if (span.iterations > 0) {
+                output << ", \"iterations\": " << span.iterations;
+            }
+            output << "}}" << (i + 1 < spans.size() ? "," : "") << "\n";
+        }
+        output << "]}" << endl;
+    }
+};
+
+#define OPERATOR_TRACE_SCOPE(name, rpn, wordLength) OperatorTrace::Scope operatorTraceScope(name, rpn, wordLength)
+#define OPERATOR_TRACE_ITERATIONS(iterations) OperatorTrace::setIterations(iterations)
+#define OPERATOR_TRACE_RESULT_BYTES(bytes) OperatorTrace::setResultBytes(bytes)
+
+#else
+
+#define OPERATOR_TRACE_SCOPE(name, rpn, wordLength)
+#define OPERATOR_TRACE_ITERATIONS(iterations)
+#define OPERATOR_TRACE_RESULT_BYTES(bytes)
+
+#endif // FORMAL_LANGUAGE_OPERATOR_TRACE
+
+#endif // FORMAL_LANGUAGE_OPERATOR_TRACE_H
@@ -0,0 +1,331 @@
+#ifndef FORMAL_LANGUAGE_PHASE_PROFILER_H
+#define FORMAL_LANGUAGE_PHASE_PROFILER_H
+
+// Аппаратные счётчики (perf_event_open) по фазам исходного алгоритма: разбор, построение
+// листьев, объединение, конкатенация, звёздочка Клини и извлечение ответа. Для каждой фазы
+// открывается своя группа счётчиков текущего потока, которая включена только пока идёт фаза,
+// поэтому вложенная фаза не попадает в объемлющую. Счётчики считают только пользовательский
+// режим и открываются без привилегий при kernel.perf_event_paranoid <= 2; счётчики, которые
+// ядро или процессор не дают открыть, в отчёте помечаются как недоступные, время и число
+// входов в фазу считаются всегда
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+
+#include "common.h"
+
+enum ProfilePhase {
+    PHASE_PARSE,
+    PHASE_LEAF,
+    PHASE_UNION,
+    PHASE_CONCATENATION,
+    PHASE_STAR,
+    PHASE_ANSWER,
+    PHASE_COUNT
+};
+
+enum ProfileCounter {
+    COUNTER_CYCLES,
+    COUNTER_INSTRUCTIONS,
+    COUNTER_L1D_MISSES,
+    COUNTER_LLC_MISSES,
+    COUNTER_BRANCH_MISSES,
+    COUNTER_COUNT
+};
+
+struct PhaseProfiler {
+public:
+    struct PhaseResult {
+        ulong calls;
+        ulong nanoseconds;
+        bool available[COUNTER_COUNT];
+        double values[COUNTER_COUNT]; // с поправкой на мультиплексирование
+    };
+
+private:
+    struct Group {
+        int fds[COUNTER_COUNT]; // -1, если счётчик не открылся
+        int leader;
+        ulong calls;
+        std::chrono::steady_clock::duration elapsed;
+    };
+
+    Group groups[PHASE_COUNT];
+    PhaseProfiler *previous;
+    ProfilePhase stack[64];
+    ulong depth;
+    std::chrono::steady_clock::time_point phaseStart;
+    string unavailableReason;
+
+    static perf_event_attr counterAttributes(ProfileCounter counter) {
+        perf_event_attr attributes;
+        std::memset(&attributes, 0, sizeof(attributes));
+        attributes.size = sizeof(attributes);
+        attributes.disabled = 1;
+        attributes.exclude_kernel = 1;
+        attributes.exclude_hv = 1;
+        attributes.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_ID | PERF_FORMAT_TOTAL_TIME_ENABLED
+                                 | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+        switch (counter) {
+            case COUNTER_CYCLES:
+                attributes.type = PERF_TYPE_HARDWARE;
+                attributes.config = PERF_COUNT_HW_CPU_CYCLES;
+                break;
+            case COUNTER_INSTRUCTIONS:
+                attributes.type = PERF_TYPE_HARDWARE;
+                attributes.config = PERF_COUNT_HW_INSTRUCTIONS;
+                break;
+            case COUNTER_L1D_MISSES:
+                attributes.type = PERF_TYPE_HW_CACHE;
+                attributes.config = PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8)
+                                    | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+                break;
+            case COUNTER_LLC_MISSES:
+                attributes.type = PERF_TYPE_HARDWARE;
+                attributes.config = PERF_COUNT_HW_CACHE_MISSES;
+                break;
+            default:
+                attributes.type = PERF_TYPE_HARDWARE;
+                attributes.config = PERF_COUNT_HW_BRANCH_MISSES;
+                break;
+        }
+        return attributes;
+    }
+
+    void openGroup(Group &group) {
+        group.leader = -1;
+        group.calls = 0;
+        group.elapsed = std::chrono::steady_clock::duration::zero();
+        for (ulong counter = 0; counter < COUNTER_COUNT; ++counter) {
+            perf_event_attr attributes = counterAttributes(static_cast<ProfileCounter>(counter));
+            int fd = static_cast<int>(syscall(SYS_perf_event_open, &attributes, 0, -1, group.leader, 0));
+            if (fd < 0 && unavailableReason.empty()) {
+                unavailableReason = string(counterName(static_cast<ProfileCounter>(counter))) + ": "
+                                    + std::strerror(errno);
+                if (errno == EACCES || errno == EPERM) {
+                    unavailableReason += " (see kernel.perf_event_paranoid)";
+                }
+            }
+            group.fds[counter] = fd;
+            if (fd >= 0 && group.leader < 0) {
+                group.leader = fd;
+            }
+        }
+    }
+
+    void setEnabled(ProfilePhase phase, bool enabled) {
+        if (groups[phase].leader >= 0) {
+            ioctl(groups[phase].leader, enabled ? PERF_EVENT_IOC_ENABLE : PERF_EVENT_IOC_DISABLE,
+                  PERF_IOC_FLAG_GROUP);
+        }
+    }
+
+    // Время, прошедшее с последнего переключения фаз, относится к фазе на вершине стека
+    void chargeElapsed() {
+        auto now = std::chrono::steady_clock::now();
+        if (depth > 0) {
+            groups[stack[depth - 1]].elapsed += now - phaseStart;
+        }
+        phaseStart = now;
+    }
+
+    static PhaseProfiler *&activeProfiler() {
+        static thread_local PhaseProfiler *profiler = nullptr;
+        return profiler;
+    }
+
+public:
+    // Профилирует текущий поток, пока объект жив
+    PhaseProfiler() : depth(0) {
+        for (Group &group : groups) {
+            openGroup(group);
+        }
+        previous = activeProfiler();
+        activeProfiler() = this;
+    }
+
+    PhaseProfiler(const PhaseProfiler &) = delete;
+    PhaseProfiler &operator=(const PhaseProfiler &) = delete;
+
+    ~PhaseProfiler() {
+        activeProfiler() = previous;
+        for (Group &group : groups) {
+            for (int fd : group.fds) {
+                if (fd >= 0) {
+                    close(fd);
+                }
+            }
+        }
+    }
+
+    static PhaseProfiler *active() {
+        return activeProfiler();
+    }
+
+    void enter(ProfilePhase phase) {
+        chargeElapsed();
+        if (depth > 0) {
+            setEnabled(stack[depth - 1], false);
+        }
+        if (depth < sizeof(stack) / sizeof(stack[0])) {
+            stack[depth] = phase;
+        }
+        ++depth;
+        ++groups[phase].calls;
+        setEnabled(phase, true);
+    }
+
+    void leave(ProfilePhase phase) {
+        setEnabled(phase, false);
+        chargeElapsed();
+        --depth;
+        if (depth > 0) {
+            setEnabled(stack[depth - 1], true);
+        }
+    }
+
+    // Пустая строка, если открылись все счётчики; иначе причина первой неудачи
+    const string &getUnavailableReason() const {
+        return unavailableReason;
+    }
+
+    PhaseResult result(ProfilePhase phase) const {
+        const Group &group = groups[phase];
+        PhaseResult result;
+        result.calls = group.calls;
+        result.nanoseconds = static_cast<ulong>(
+                std::chrono::duration_cast<std::chrono::nanoseconds>(group.elapsed).count());
+        for (ulong counter = 0; counter < COUNTER_COUNT; ++counter) {
+            result.available[counter] = false;
+            result.values[counter] = 0;
+        }
+        if (group.leader < 0) {
+            return result;
+        }
+
+        // PERF_FORMAT_GROUP: nr, time_enabled, time_running, затем пары (value, id)
+        unsigned long long buffer[3 + 2 * COUNTER_COUNT];
+        if (read(group.leader, buffer, sizeof(buffer)) <= 0) {
+            return result;
+        }
+        unsigned long long enabledTime = buffer[1];
+        unsigned long long runningTime = buffer[2];
+        double scale = runningTime == 0 ? 0.0 : static_cast<double>(enabledTime) / runningTime;
+
+        ulong index = 0;
+        for (ulong counter = 0; counter < COUNTER_COUNT; ++counter) {
+            if (group.fds[counter] < 0) {
+                continue;
+            }
+            result.available[counter] = runningTime > 0 || enabledTime == 0;
+            result.values[counter] = static_cast<double>(buffer[3 + 2 * index]) * scale;
+            ++index;
+        }
+        return result;
+    }
+
+    static const char *phaseName(ProfilePhase phase) {
+        static const char *names[PHASE_COUNT] = {"parse", "leaf", "union", "concatenation", "star", "answer"};
+        return names[phase];
+    }
+
+    static const char *counterName(ProfileCounter counter) {
+        static const char *names[COUNTER_COUNT] = {"cycles", "instructions", "l1d_misses", "llc_misses",
+                                                   "branch_misses"};
+        return names[counter];
+    }
+
+    void printTable(FILE *output) const {
+        if (!unavailableReason.empty()) {
+            std::fprintf(output, "some counters are unavailable: %s\n", unavailableReason.c_str());
+        }
+        std::fprintf(output, "%-14s %10s %12s", "phase", "calls", "time_ms");
+        for (ulong counter = 0; counter < COUNTER_COUNT; ++counter) {
+            std::fprintf(output, " %15s", counterName(static_cast<ProfileCounter>(counter)));
+        }
+        std::fprintf(output, " %6s %9s\n", "ipc", "llc/kinst");
+
+        for (ulong phase = 0; phase < PHASE_COUNT; ++phase) {
+            PhaseResult phaseResult = result(static_cast<ProfilePhase>(phase));
+            std::fprintf(output, "%-14s %10lu %12.3f", phaseName(static_cast<ProfilePhase>(phase)), phaseResult.calls,
+                         phaseResult.nanoseconds / 1e6);
+            for (ulong counter = 0; counter < COUNTER_COUNT; ++counter) {
+                if (phaseResult.available[counter]) {
+                    std::fprintf(output, " %15.0f", phaseResult.values[counter]);
+                } else {
+                    std::fprintf(output, " %15s", "n/a");
+                }
+            }
+            if (phaseResult.available[COUNTER_CYCLES] && phaseResult.available[COUNTER_INSTRUCTIONS]
+                && phaseResult.values[COUNTER_CYCLES] > 0) {
+                std::fprintf(output, " %6.2f",
+                             phaseResult.values[COUNTER_INSTRUCTIONS] / phaseResult.values[COUNTER_CYCLES]);
+            } else {
+                std::fprintf(output, " %6s", "n/a");
+            }
+            if (phaseResult.available[COUNTER_LLC_MISSES] && phaseResult.available[COUNTER_INSTRUCTIONS]
+                && phaseResult.values[COUNTER_INSTRUCTIONS] > 0) {
+                std::fprintf(output, " %9.3f",
+                             1000 * phaseResult.values[COUNTER_LLC_MISSES] / phaseResult.values[COUNTER_INSTRUCTIONS]);
+            } else {
+                std::fprintf(output, " %9s", "n/a");
+            }
+            std::fprintf(output, "\n");
+        }
+    }
+
+    void printJson(FILE *output) const {
+        std::fprintf(output, "{\"unavailable_reason\": ");
+        if (unavailableReason.empty()) {
+            std::fprintf(output, "null");
+        } else {
+            std::fprintf(output, "\"%s\"", unavailableReason.c_str());
+        }
+        std::fprintf(output, ", \"phases\": [\n");
+        for (ulong phase = 0; phase < PHASE_COUNT; ++phase) {
+            PhaseResult phaseResult = result(static_cast<ProfilePhase>(phase));
+            std::fprintf(output, "  {\"phase\": \"%s\", \"calls\": %lu, \"nanoseconds\": %lu",
+                         phaseName(static_cast<ProfilePhase>(phase)), phaseResult.calls, phaseResult.nanoseconds);
+            for (ulong counter = 0; counter < COUNTER_COUNT; ++counter) {
+                std::fprintf(output, ", \"%s\": ", counterName(static_cast<ProfileCounter>(counter)));
+                if (phaseResult.available[counter]) {
+                    std::fprintf(output, "%.0f", phaseResult.values[counter]);
+                } else {
+                    std::fprintf(output, "null");
+                }
+            }
+            std::fprintf(output, "}%s\n", phase + 1 < PHASE_COUNT ? "," : "");
+        }
+        std::fprintf(output, "]}\n");
+    }
+};
+
+// Фаза на время жизни объекта; без активного профилировщика в потоке ничего не делает
+struct ProfilePhaseScope {
+private:
+    PhaseProfiler *profiler;
+    ProfilePhase phase;
+
+public:
+    explicit ProfilePhaseScope(ProfilePhase phase) : profiler(PhaseProfiler::active()), phase(phase) {
+        if (profiler != nullptr) {
+            profiler->enter(phase);
+        }
+    }
+
+    ProfilePhaseScope(const ProfilePhaseScope &) = delete;
+    ProfilePhaseScope &operator=(const ProfilePhaseScope &) = delete;
+
+    ~ProfilePhaseScope() {
+        if (profiler != nullptr) {
+            profiler->leave(phase);
+        }
+    }
+};
+
+#endif // FORMAL_LANGUAGE_PHASE_PROFILER_H
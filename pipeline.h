@@ -0,0 +1,364 @@
+#ifndef FORMAL_LANGUAGE_PIPELINE_H
+#define FORMAL_LANGUAGE_PIPELINE_H
+
+// Многопоточное выполнение запросов
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <climits>
+
+#include "automaton.h"
+#include "storage.h"
+#include "trace.h"
+
+// Ограниченная очередь без блокировок для нескольких писателей и читателей
+// (кольцевой буфер Вьюкова: у каждой ячейки свой счётчик поколения). push и pop недолго
+// повторяют попытку, а затем засыпают на условной переменной, чтобы ожидающие потоки
+// не занимали ядра, пока стадия чтения ждёт ввода
+template <typename T>
+struct BoundedQueue {
+private:
+    struct Cell {
+        std::atomic<ulong> sequence;
+        T value;
+    };
+
+    // Число попыток до засыпания
+    static const ulong SPIN_ATTEMPTS = 64;
+
+    std::unique_ptr<Cell[]> cells;
+    ulong mask;
+    alignas(64) std::atomic<ulong> enqueuePosition;
+    alignas(64) std::atomic<ulong> dequeuePosition;
+
+    // Спящие писатели и читатели. Поток сначала увеличивает счётчик, затем под mutex ещё раз
+    // пробует операцию и засыпает; другая сторона после операции смотрит на счётчик и будит
+    // под тем же mutex, поэтому пробуждение не теряется
+    std::mutex mutex;
+    std::condition_variable notFull;
+    std::condition_variable notEmpty;
+    std::atomic<ulong> sleepingPushers;
+    std::atomic<ulong> sleepingPoppers;
+
+    void wake(std::atomic<ulong> &sleeping, std::condition_variable &condition) {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (sleeping.load(std::memory_order_relaxed) != 0) {
+            std::lock_guard<std::mutex> lock(mutex);
+            condition.notify_one();
+        }
+    }
+
+    // Повторяет attempt, пока она не удастся: сначала SPIN_ATTEMPTS раз подряд, потом во сне
+    template <typename Attempt>
+    void waitFor(Attempt attempt, std::atomic<ulong> &sleeping, std::condition_variable &condition) {
+        for (ulong i = 0; i < SPIN_ATTEMPTS; ++i) {
+            if (attempt()) {
+                return;
+            }
+            std::this_thread::yield();
+        }
+        std::unique_lock<std::mutex> lock(mutex);
+        sleeping.fetch_add(1, std::memory_order_seq_cst);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        while (!attempt()) {
+            condition.wait(lock);
+        }
+        sleeping.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+public:
+    // Ёмкость округляется вверх до степени двойки
+    explicit BoundedQueue(ulong capacity) :
+            enqueuePosition(0), dequeuePosition(0), sleepingPushers(0), sleepingPoppers(0) {
+        ulong size = 2;
+        while (size < capacity) {
+            size *= 2;
+        }
+        cells.reset(new Cell[size]);
+        mask = size - 1;
+        for (ulong i = 0; i < size; ++i) {
+            cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    bool tryPush(T &value) {
+        ulong position = enqueuePosition.load(std::memory_order_relaxed);
+        while (true) {
+            Cell &cell = cells[position & mask];
+            ulong sequence = cell.sequence.load(std::memory_order_acquire);
+            if (sequence == position) {
+                if (enqueuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                    cell.value = std::move(value);
+                    cell.sequence.store(position + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (sequence < position) {
+                return false; // очередь заполнена
+            } else {
+                position = enqueuePosition.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    bool tryPop(T &value) {
+        ulong position = dequeuePosition.load(std::memory_order_relaxed);
+        while (true) {
+            Cell &cell = cells[position & mask];
+            ulong sequence = cell.sequence.load(std::memory_order_acquire);
+            if (sequence == position + 1) {
+                if (dequeuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                    value = std::move(cell.value);
+                    cell.sequence.store(position + mask + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (sequence < position + 1) {
+                return false; // очередь пуста
+            } else {
+                position = dequeuePosition.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    void push(T value) {
+        waitFor([&] { return tryPush(value); }, sleepingPushers, notFull);
+        wake(sleepingPoppers, notEmpty);
+    }
+
+    T pop() {
+        T value;
+        waitFor([&] { return tryPop(value); }, sleepingPoppers, notEmpty);
+        wake(sleepingPushers, notFull);
+        return value;
+    }
+};
+
+// Конвейер пакетной обработки из трёх стадий: чтение с проверкой слова и компиляцией
+// выражения (вызывающий поток), вычисление ответов (workerCount потоков) и вывод ответов
+// в исходном порядке (отдельный поток). Стадии связаны ограниченными очередями без блокировок.
+// Чтение не уходит дальше чем на окно из queueCapacity * workerCount запросов от первого
+// невыведенного ответа, поэтому за одним медленным запросом копится не больше окна ответов
+struct PipelineExecutor {
+public:
+    // Запрос, подготовленный стадией чтения: либо скомпилированное выражение и проверенное
+    // слово, либо сообщение об ошибке разбора
+    struct Query {
+        ulong sequence;
+        const CompiledExpression *expression;
+        string_view word;
+        string error;
+    };
+
+private:
+    struct Answer {
+        ulong sequence;
+        string text;
+    };
+
+    static const ulong FINISHED = ULONG_MAX;
+    // номер запроса-признака конца работы
+
+    ulong workerCount;
+    ulong window;
+    ResultCache *resultCache;
+    TraceWriter *trace;
+    BoundedQueue<Query> queries;
+    BoundedQueue<Answer> answers;
+
+    // Номер первого невыведенного ответа; чтение ждёт, пока окно не сдвинется
+    std::atomic<ulong> writtenSequence;
+    std::atomic<bool> readerWaiting;
+    std::mutex windowMutex;
+    std::condition_variable windowMoved;
+
+    void waitForWindow(ulong sequence) {
+        if (sequence < writtenSequence.load(std::memory_order_acquire) + window) {
+            return;
+        }
+        std::unique_lock<std::mutex> lock(windowMutex);
+        readerWaiting.store(true, std::memory_order_seq_cst);
+        windowMoved.wait(lock, [&] { return sequence < writtenSequence.load(std::memory_order_seq_cst) + window; });
+        readerWaiting.store(false, std::memory_order_relaxed);
+    }
+
+    void moveWindow(ulong sequence) {
+        writtenSequence.store(sequence, std::memory_order_seq_cst);
+        if (readerWaiting.load(std::memory_order_seq_cst)) {
+            std::lock_guard<std::mutex> lock(windowMutex);
+            windowMoved.notify_one();
+        }
+    }
+
+    ulong evaluateCached(const CompiledExpression &expression, string_view word, TraceEngine &engine) {
+        engine = TRACE_AUTOMATON;
+        if (resultCache == nullptr) {
+            return expression.longestFactorOfValidWord(word);
+        }
+        ResultCache::Key key = ResultCache::makeKey(expression.getExpression(), word);
+        ulong answer;
+        if (resultCache->lookup(key, answer)) {
+            engine = TRACE_RESULT_CACHE;
+        } else {
+            answer = expression.longestFactorOfValidWord(word);
+            resultCache->store(key, answer);
+        }
+        return answer;
+    }
+
+    void evaluate() {
+        while (true) {
+            Query query = queries.pop();
+            if (query.sequence == FINISHED) {
+                answers.push(Answer{FINISHED, string()});
+                return;
+            }
+
+            Answer answer{query.sequence, query.error};
+            if (query.expression != nullptr) {
+                auto start = std::chrono::steady_clock::now();
+                TraceEngine engine;
+                ulong length = evaluateCached(*query.expression, query.word, engine);
+                if (trace != nullptr) {
+                    trace->record(engine, std::chrono::steady_clock::now() - start, false, length,
+                                  query.expression->getExpression(), query.word);
+                }
+                answer.text = std::to_string(length);
+            }
+            answers.push(std::move(answer));
+        }
+    }
+
+    void writeAnswers(std::ostream &output) {
+        std::unordered_map<ulong, string> outOfOrder;
+        ulong nextSequence = 0;
+        ulong finishedWorkers = 0;
+        string buffer;
+
+        while (finishedWorkers < workerCount) {
+            Answer answer = answers.pop();
+            if (answer.sequence == FINISHED) {
+                ++finishedWorkers;
+                continue;
+            }
+            outOfOrder[answer.sequence] = std::move(answer.text);
+
+            ulong firstSequence = nextSequence;
+            for (auto next = outOfOrder.find(nextSequence); next != outOfOrder.end();
+                 next = outOfOrder.find(nextSequence)) {
+                buffer += next->second;
+                buffer += '\n';
+                outOfOrder.erase(next);
+                ++nextSequence;
+            }
+            if (nextSequence != firstSequence) {
+                moveWindow(nextSequence);
+            }
+            if (buffer.length() >= STREAM_BLOCK_SIZE) {
+                output.write(buffer.data(), static_cast<std::streamsize>(buffer.length()));
+                buffer.clear();
+            }
+        }
+
+        output.write(buffer.data(), static_cast<std::streamsize>(buffer.length()));
+        output.flush();
+    }
+
+public:
+    // Если resultCache задан, ответы сначала ищутся в нём; если задан trace, в него
+    // записываются все вычисленные запросы (запросы с ошибкой разбора не записываются)
+    PipelineExecutor(ulong workerCount, ulong queueCapacity, ResultCache *resultCache, TraceWriter *trace) :
+            workerCount(max(workerCount, 1UL)), window(max(queueCapacity, 1UL) * max(workerCount, 1UL)),
+            resultCache(resultCache), trace(trace), queries(queueCapacity), answers(queueCapacity),
+            writtenSequence(0), readerWaiting(false) {}
+
+    // readQuery заполняет очередной запрос (кроме номера) и возвращает false, когда вход закончился
+    void run(const std::function<bool(Query &)> &readQuery, std::ostream &output) {
+        std::vector<std::thread> workers;
+        for (ulong i = 0; i < workerCount; ++i) {
+            workers.emplace_back(&PipelineExecutor::evaluate, this);
+        }
+        std::thread writer(&PipelineExecutor::writeAnswers, this, std::ref(output));
+
+        for (ulong sequence = 0;; ++sequence) {
+            Query query{sequence, nullptr, string_view(), string()};
+            if (!readQuery(query)) {
+                break;
+            }
+            waitForWindow(sequence);
+            queries.push(std::move(query));
+        }
+        for (ulong i = 0; i < workerCount; ++i) {
+            queries.push(Query{FINISHED, nullptr, string_view(), string()});
+        }
+
+        for (std::thread &worker : workers) {
+            worker.join();
+        }
+        writer.join();
+    }
+};
+
+const ulong PIPELINE_QUEUE_CAPACITY = 1 << 12;
+
+// Пул рабочих потоков с общей очередью задач
+struct WorkerPool {
+private:
+    std::vector<std::thread> workers;
+    std::deque<std::function<void()> > tasks;
+    std::mutex mutex;
+    std::condition_variable hasTask;
+    bool stopping;
+
+    void work() {
+        while (true) {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                hasTask.wait(lock, [this] { return stopping || !tasks.empty(); });
+                if (tasks.empty()) {
+                    return;
+                }
+                task = std::move(tasks.front());
+                tasks.pop_front();
+            }
+            task();
+        }
+    }
+
+public:
+    explicit WorkerPool(ulong threadCount) : stopping(false) {
+        for (ulong i = 0; i < max(threadCount, 1UL); ++i) {
+            workers.emplace_back(&WorkerPool::work, this);
+        }
+    }
+
+    WorkerPool(const WorkerPool &) = delete;
+    WorkerPool &operator=(const WorkerPool &) = delete;
+
+    ~WorkerPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        hasTask.notify_all();
+        for (std::thread &worker : workers) {
+            worker.join();
+        }
+    }
+
+    void submit(std::function<void()> task) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            tasks.push_back(std::move(task));
+        }
+        hasTask.notify_one();
+    }
+};
+
+#endif // FORMAL_LANGUAGE_PIPELINE_H
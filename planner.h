@@ -0,0 +1,433 @@
+#ifndef FORMAL_LANGUAGE_PLANNER_H
+#define FORMAL_LANGUAGE_PLANNER_H
+
+// Выбор движка для запроса по оценке стоимости. Оценки -- верхние границы числа элементарных
+// операций (ячеек таблиц Operand, шагов по позициям и переходам автомата), вычисленные по форме
+// выражения и длине слова без разбора выражения каким-либо движком. Движки сравниваются по
+// времени: операции переводятся в наносекунды коэффициентами TuningConfig
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+#include "common.h"
+#include "tuning.h"
+
+enum PlanEngine {
+    ENGINE_OPERAND,   // динамика по подсловам (Solver)
+    ENGINE_AUTOMATON, // автомат позиций (CompiledExpression)
+    ENGINE_FINITE,    // суффиксный автомат конечного языка (FiniteLanguageIndex)
+    ENGINE_COUNT
+};
+
+inline const char *planEngineName(PlanEngine engine) {
+    static const char *names[ENGINE_COUNT] = {"operand", "automaton", "finite"};
+    return names[engine];
+}
+
+// Многочлен степени не выше 4 от длины подслова L: оценка работы Operand на подслове
+struct LengthPolynomial {
+    static const ulong DEGREE = 4;
+
+    double coefficients[DEGREE + 1];
+
+    LengthPolynomial() : coefficients{0, 0, 0, 0, 0} {}
+
+    // constant + linear * L
+    static LengthPolynomial linear(double constant, double linear) {
+        LengthPolynomial result;
+        result.coefficients[0] = constant;
+        result.coefficients[1] = linear;
+        return result;
+    }
+
+    // factor * L^degree
+    static LengthPolynomial power(ulong degree, double factor = 1) {
+        LengthPolynomial result;
+        result.coefficients[degree] = factor;
+        return result;
+    }
+
+    LengthPolynomial operator+(const LengthPolynomial &other) const {
+        LengthPolynomial result;
+        for (ulong i = 0; i <= DEGREE; ++i) {
+            result.coefficients[i] = coefficients[i] + other.coefficients[i];
+        }
+        return result;
+    }
+
+    // Оценки в ExpressionShape не выходят за степень 4; старшие члены отбрасываются
+    LengthPolynomial operator*(const LengthPolynomial &other) const {
+        LengthPolynomial result;
+        for (ulong i = 0; i <= DEGREE; ++i) {
+            for (ulong j = 0; i + j <= DEGREE; ++j) {
+                result.coefficients[i + j] += coefficients[i] * other.coefficients[j];
+            }
+        }
+        return result;
+    }
+
+    double at(double length) const {
+        double value = 0;
+        for (ulong i = DEGREE + 1; i-- > 0;) {
+            value = value * length + coefficients[i];
+        }
+        return value;
+    }
+};
+
+// Форма выражения в обратной польской записи: размер, число позиций (вхождений букв),
+// число операторов каждого вида, глубина вложенности звёздочек и оценка сверху суммы длин
+// слов языка (бесконечность, если язык бесконечен)
+struct ExpressionShape {
+    ulong size;
+    ulong positions;
+    ulong leaves;
+    ulong unions;
+    ulong concatenations;
+    ulong stars;
+    ulong starDepth;
+    double finiteLetters;
+
+    // Одно вычисление Operand на подслове длины L > 256: операции над списками подслов
+    // (sparseWork) и над плотными таблицами (denseWork)
+    LengthPolynomial sparseWork;
+    LengthPolynomial denseWork;
+
+private:
+    // Таблица подвыражения при вычислении Operand. width -- сколько длин подслов с одним началом
+    // может быть верно: у языка без звёздочек не больше числа его слов и числа длин от
+    // minLength до maxLength, у звёздочки -- L / shortest, где shortest -- длина самого
+    // короткого непустого слова. В таблице L * width верных ячеек из L^2 / 2, и по этой доле
+    // (как Operand::adaptRepresentation) она считается списком или плотной. literal -- слово
+    // из букв, literalStar -- w* или (w*)*: их таблицы строит literal.h
+    struct OperandNode {
+        double words;
+        double minLength;
+        double maxLength;
+        double shortest;
+        LengthPolynomial width;
+        bool dense;
+        bool literal;
+        bool literalStar;
+
+        LengthPolynomial intervals() const {
+            return width * LengthPolynomial::power(1);
+        }
+    };
+
+    double sparseDensity;
+
+    // width у языка без звёздочек и у остальных; плотность -- 2 * width / L при больших L
+    void setWidth(OperandNode &node, double linearWidth) const {
+        if (std::isinf(node.maxLength)) {
+            node.width = LengthPolynomial::linear(0, std::min(linearWidth, 1.0));
+            node.dense = 2 * node.width.coefficients[1] > sparseDensity;
+        } else {
+            node.width = LengthPolynomial::linear(std::min(node.words, node.maxLength - node.minLength + 1), 0);
+            node.dense = false;
+        }
+    }
+
+    // Конкатенация таблиц: списков -- каждое подслово left продолжается подсловами right с его
+    // конца, и ещё L на таблицы префиксов и суффиксов слова; списка и таблицы -- строка таблицы
+    // на каждое подслово списка (у таблицы слева -- в среднем половина строки); двух таблиц --
+    // L^3 / 6. К плотному результату добавляется пересчёт доли верных ячеек, L^2 / 2
+    void addConcatenationWork(const OperandNode &left, const OperandNode &right, const LengthPolynomial &times) {
+        LengthPolynomial length = LengthPolynomial::power(1);
+        if (!left.dense && !right.dense) {
+            sparseWork = sparseWork + times * (left.intervals() * (right.width + LengthPolynomial::linear(1, 0))
+                                               + LengthPolynomial::power(1));
+        } else if (!left.dense) {
+            denseWork = denseWork + times * (left.intervals() * length + LengthPolynomial::power(2));
+        } else if (!right.dense) {
+            denseWork = denseWork + times * (right.intervals() * length * LengthPolynomial::linear(0.5, 0)
+                                             + LengthPolynomial::power(2));
+        } else {
+            denseWork = denseWork + times * (LengthPolynomial::power(3, 1.0 / 6) + LengthPolynomial::power(2));
+        }
+    }
+
+    // Объединение: слияние списков и таблиц префиксов и суффиксов или проход по плотной таблице
+    // и пересчёт доли верных ячеек
+    void addUnionWork(const OperandNode &left, const OperandNode &right, const LengthPolynomial &times) {
+        if (!left.dense && !right.dense) {
+            sparseWork = sparseWork + times * (left.intervals() + right.intervals() + LengthPolynomial::power(1));
+        } else {
+            denseWork = denseWork + times * LengthPolynomial::power(2);
+        }
+    }
+
+    static OperandNode leafNode(char character) {
+        bool letter = character != EPSILON;
+        return OperandNode{1, letter ? 1.0 : 0.0, letter ? 1.0 : 0.0, letter ? 1.0 : INFINITY,
+                           LengthPolynomial::linear(1, 0), false, letter, false};
+    }
+
+    OperandNode combine(char character, const OperandNode &left, const OperandNode &right) {
+        OperandNode result;
+        LengthPolynomial once = LengthPolynomial::linear(1, 0);
+        if (character == '+') {
+            addUnionWork(left, right, once);
+            result = OperandNode{left.words + right.words, std::min(left.minLength, right.minLength),
+                                 std::max(left.maxLength, right.maxLength), std::min(left.shortest, right.shortest),
+                                 LengthPolynomial(), false, false, false};
+        } else {
+            addConcatenationWork(left, right, once);
+            result = OperandNode{left.words * right.words, left.minLength + right.minLength,
+                                 left.maxLength + right.maxLength,
+                                 std::min(left.shortest + right.minLength, left.minLength + right.shortest),
+                                 LengthPolynomial(), false, left.literal && right.literal, false};
+        }
+        setWidth(result, left.width.coefficients[1] + right.width.coefficients[1]);
+        return result;
+    }
+
+    // Звёздочка литерала -- цепочки вхождений, по ячейке на подслово результата. Иначе 2L + 2
+    // итераций объединяют сумму степеней (таблицу результата) со степенью e^n операнда e, и пока
+    // e^n не пуста (n <= L / shortest), умножают её на e. У e со словами длин от minLength до
+    // maxLength в e^n в среднем n * (maxLength - minLength) / 2 + 1 длин с одним началом
+    OperandNode star(const OperandNode &operand) {
+        if (std::isinf(operand.shortest)) {
+            return leafNode(EPSILON); // 1* = 1
+        }
+        OperandNode result{INFINITY, 0, INFINITY, operand.shortest, LengthPolynomial(), false, false,
+                           operand.literal || operand.literalStar};
+        setWidth(result, 1 / operand.shortest);
+        if (result.literalStar) {
+            (result.dense ? denseWork : sparseWork) = (result.dense ? denseWork : sparseWork) + result.intervals();
+            return result;
+        }
+
+        double spread = std::min(1.0, (operand.maxLength - operand.minLength) / 2) / operand.shortest;
+        OperandNode power = result;
+        power.width = LengthPolynomial::linear(1, spread);
+        power.dense = 2 * spread > sparseDensity;
+        addConcatenationWork(power, operand, LengthPolynomial::linear(1, 1 / operand.shortest));
+        addUnionWork(result, power, LengthPolynomial::linear(2, 2));
+        return result;
+    }
+
+public:
+    // Некорректная запись не бросает исключение: оценка строится по тому, что удалось разобрать,
+    // а ошибку сообщит выбранный движок. sparseDensity -- порог плотности таблиц Operand
+    // (TuningConfig::operandSparseDensity)
+    explicit ExpressionShape(string_view expression,
+                             double sparseDensity = TuningConfig::current().operandSparseDensity) :
+            size(expression.length()), positions(0), leaves(0), unions(0), concatenations(0), stars(0),
+            starDepth(0), finiteLetters(0), sparseDensity(sparseDensity) {
+        std::vector<ulong> depths;
+        std::vector<std::pair<double, double> > sizes;
+        std::vector<OperandNode> nodes;
+        // sizes -- оценки сверху числа слов и суммы их длин у языков подвыражений
+        for (char character : expression) {
+            if (character == '+' || character == '.') {
+                ++(character == '+' ? unions : concatenations);
+                if (depths.size() >= 2) {
+                    ulong right = depths.back();
+                    depths.pop_back();
+                    depths.back() = max(depths.back(), right);
+
+                    std::pair<double, double> rightSize = sizes.back();
+                    sizes.pop_back();
+                    std::pair<double, double> &leftSize = sizes.back();
+                    if (character == '+') {
+                        leftSize = {leftSize.first + rightSize.first, leftSize.second + rightSize.second};
+                    } else {
+                        leftSize = {leftSize.first * rightSize.first,
+                                    leftSize.second * rightSize.first + rightSize.second * leftSize.first};
+                    }
+
+                    OperandNode rightNode = nodes.back();
+                    nodes.pop_back();
+                    nodes.back() = combine(character, nodes.back(), rightNode);
+                }
+            } else if (character == '*') {
+                ++stars;
+                if (!depths.empty()) {
+                    ++depths.back();
+                    starDepth = max(starDepth, depths.back());
+                    if (sizes.back().second != 0) {
+                        sizes.back() = {INFINITY, INFINITY}; // 1* = 1, остальные звёздочки бесконечны
+                    }
+
+                    nodes.back() = star(nodes.back());
+                }
+            } else {
+                ++leaves;
+                if (character != EPSILON) {
+                    ++positions;
+                }
+                depths.push_back(0);
+                sizes.push_back({1, character != EPSILON ? 1 : 0});
+                // Лист -- проход по подслову
+                sparseWork = sparseWork + LengthPolynomial::power(1);
+                nodes.push_back(leafNode(character));
+            }
+        }
+        if (!sizes.empty()) {
+            finiteLetters = sizes.back().second;
+        }
+    }
+
+    // Без звёздочек язык конечен и его слова не длиннее числа позиций
+    bool isFinite() const {
+        return stars == 0;
+    }
+};
+
+struct QueryPlan {
+private:
+    ExpressionShape shape;
+    ulong wordLength;
+    double costs[ENGINE_COUNT];
+    double nanoseconds[ENGINE_COUNT];
+    PlanEngine engine;
+    string reason;
+
+    // Solver перебирает подслова по возрастанию длины до первой длины без совпадений; в худшем
+    // случае это все длины, а у конечного языка -- не больше числа позиций плюс одна. Длины до 256
+    // вычисляет FixedOperand (fixed), более длинные -- Operand: его работа над списками (sparse)
+    // и плотными таблицами (dense) стоит по-разному
+    void operandCosts(double &fixed, double &sparse, double &dense) const {
+        ulong maxLength = wordLength;
+        if (shape.isFinite()) {
+            maxLength = std::min(wordLength, shape.positions + 1);
+        }
+        fixed = sparse = dense = 0;
+        for (ulong length = 1; length <= maxLength; ++length) {
+            double substrings = static_cast<double>(wordLength - length + 1);
+            if (length <= 256) {
+                fixed += substrings * fixedOperandEvaluationCost(static_cast<double>(length));
+            } else {
+                sparse += substrings * sparseOperandEvaluationCost(static_cast<double>(length));
+                dense += substrings * denseOperandEvaluationCost(static_cast<double>(length));
+            }
+        }
+    }
+
+    // Построение автомата: проход по записи и не больше positions^2 переходов; каждый символ
+    // слова -- проход по позициям и переходам по его букве (в среднем треть всех переходов)
+    double automatonCost() const {
+        double positions = static_cast<double>(shape.positions);
+        double transitions = positions * positions;
+        double build = static_cast<double>(shape.size) + transitions;
+        double step = 3 * positions + transitions / ALPHABET_SIZE + 1;
+        return build + static_cast<double>(wordLength) * step;
+    }
+
+    // Перечисление языка и построение суффиксного автомата -- несколько операций на букву слов
+    // языка, затем по шагу на символ слова; без индекса (язык бесконечен или больше
+    // finite_language_limit) движок недоступен
+    double finiteCost(const TuningConfig &tuning) const {
+        if (!(shape.finiteLetters <= tuning.finiteLanguageLimit)) {
+            return INFINITY;
+        }
+        return 4 * shape.finiteLetters + static_cast<double>(shape.size) + 2 * static_cast<double>(wordLength);
+    }
+
+public:
+    QueryPlan(string_view expression, ulong wordLength, const TuningConfig &tuning = TuningConfig::current()) :
+            QueryPlan(ExpressionShape(expression, tuning.operandSparseDensity), wordLength, tuning) {}
+
+    // Форма разобрана заранее: так выражение, скомпилированное один раз, планируется для каждого
+    // слова без повторного разбора записи
+    QueryPlan(const ExpressionShape &shape, ulong wordLength, const TuningConfig &tuning = TuningConfig::current()) :
+            shape(shape), wordLength(wordLength), engine(ENGINE_OPERAND), reason("cheapest estimate") {
+        double fixedOperandCost;
+        double sparseOperandCost;
+        double denseOperandCost;
+        operandCosts(fixedOperandCost, sparseOperandCost, denseOperandCost);
+        costs[ENGINE_OPERAND] = fixedOperandCost + sparseOperandCost + denseOperandCost;
+        costs[ENGINE_AUTOMATON] = automatonCost();
+        costs[ENGINE_FINITE] = finiteCost(tuning);
+        nanoseconds[ENGINE_OPERAND] = fixedOperandCost * tuning.fixedOperandNanosecondsPerOp
+                                      + sparseOperandCost * tuning.operandSparseNanosecondsPerOp
+                                      + denseOperandCost * tuning.operandDenseNanosecondsPerOp;
+        nanoseconds[ENGINE_AUTOMATON] = costs[ENGINE_AUTOMATON] * tuning.automatonNanosecondsPerOp;
+        // Шаг суффиксного автомата -- один переход, как шаг автомата позиций по одной позиции
+        nanoseconds[ENGINE_FINITE] = costs[ENGINE_FINITE] * tuning.automatonNanosecondsPerOp;
+        for (ulong candidate = 0; candidate < ENGINE_COUNT; ++candidate) {
+            if (nanoseconds[candidate] < nanoseconds[engine]) {
+                engine = static_cast<PlanEngine>(candidate);
+            }
+        }
+    }
+
+    // Движок, заданный явно или нужный для запрошенной возможности, вместо самого дешёвого
+    void force(PlanEngine forcedEngine, const string &forcedReason) {
+        engine = forcedEngine;
+        reason = forcedReason;
+    }
+
+    PlanEngine getEngine() const {
+        return engine;
+    }
+
+    // Одно вычисление FixedOperand на подслове длины length до 256: строка таблицы занимает
+    // rowWords машинных слов, листья и объединения проходят по length строкам, конкатенация
+    // сдвигает по строке на каждую из около length^2 / 2 ячеек, звёздочка -- 2 * length + 2
+    // конкатенаций и объединений
+    double fixedOperandEvaluationCost(double length) const {
+        double rowWords = length <= 64 ? 1 : length <= 128 ? 2 : 4;
+        double cells = length * rowWords;
+        double concatenation = length * length / 2 * rowWords + 3 * cells;
+        return static_cast<double>(shape.leaves + shape.unions) * cells
+               + static_cast<double>(shape.concatenations) * concatenation
+               + static_cast<double>(shape.stars) * (2 * length + 2) * (concatenation + cells);
+    }
+
+    // Одно вычисление Operand на подслове длины length больше 256: операции над списками подслов
+    double sparseOperandEvaluationCost(double length) const {
+        return shape.sparseWork.at(length);
+    }
+
+    // То же, операции над плотными таблицами
+    double denseOperandEvaluationCost(double length) const {
+        return shape.denseWork.at(length);
+    }
+
+    const ExpressionShape &getShape() const {
+        return shape;
+    }
+
+    // Движок может ответить на запрос (у finite -- язык конечен и не больше finite_language_limit)
+    bool isAvailable(PlanEngine candidate) const {
+        return std::isfinite(costs[candidate]);
+    }
+
+    // Оценка в операциях
+    double getCost(PlanEngine candidate) const {
+        return costs[candidate];
+    }
+
+    // Оценка в наносекундах
+    double getNanoseconds(PlanEngine candidate) const {
+        return nanoseconds[candidate];
+    }
+
+    void print(FILE *output) const {
+        std::fprintf(output, "expression: size %lu, positions %lu, unions %lu, concatenations %lu, stars %lu, "
+                             "star depth %lu", shape.size, shape.positions, shape.unions, shape.concatenations,
+                     shape.stars, shape.starDepth);
+        if (std::isfinite(shape.finiteLetters)) {
+            std::fprintf(output, ", finite language of at most %.6g letters", shape.finiteLetters);
+        }
+        std::fprintf(output, "\n");
+        std::fprintf(output, "word length: %lu\n", wordLength);
+        std::fprintf(output, "%-10s %14s %14s\n", "engine", "estimated_ops", "estimated_ms");
+        for (ulong candidate = 0; candidate < ENGINE_COUNT; ++candidate) {
+            const char *name = planEngineName(static_cast<PlanEngine>(candidate));
+            const char *mark = candidate == engine ? "  <- plan" : "";
+            if (!isAvailable(static_cast<PlanEngine>(candidate))) {
+                std::fprintf(output, "%-10s %14s %14s%s\n", name, "-", "-", mark);
+                continue;
+            }
+            std::fprintf(output, "%-10s %14.3g %14.3g%s\n", name, costs[candidate], nanoseconds[candidate] / 1e6, mark);
+        }
+        std::fprintf(output, "plan: %s (%s)\n", planEngineName(engine), reason.c_str());
+    }
+};
+
+#endif // FORMAL_LANGUAGE_PLANNER_H
@@ -0,0 +1,250 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "operand.h"
+#include "automaton.h"
+#include "storage.h"
+#include "trace.h"
+
+// Воспроизведение журнала запросов, записанного с --trace: каждый запрос решается заново
+// текущей сборкой в threads потоках, печатаются распределение задержек (p50/p99/p999) в
+// сравнении с записанным и запросы, ответ на которые изменился:
+// replay TRACE [--threads N] [--engine recorded|automaton|operand] [--cache-bytes B]
+//              [--max-mismatches K] [--json]
+// Код возврата 2, если есть несовпадения ответов
+
+namespace {
+
+enum ReplayEngine {
+    REPLAY_RECORDED,  // тот же движок, что при записи; ответы из кэша пересчитываются автоматом
+    REPLAY_AUTOMATON,
+    REPLAY_OPERAND
+};
+
+struct Outcome {
+    ulong latencyNanoseconds;
+    bool failed;
+    ulong answer;
+};
+
+struct Replayer {
+private:
+    const std::vector<TraceRecord> &records;
+    ReplayEngine engine;
+    CompileCache cache;
+    std::atomic<ulong> nextRecord;
+
+    Outcome solve(const TraceRecord &record) {
+        bool useOperand = engine == REPLAY_OPERAND || (engine == REPLAY_RECORDED && record.engine == TRACE_OPERAND);
+        auto start = std::chrono::steady_clock::now();
+        Outcome outcome{0, false, 0};
+        try {
+            if (useOperand) {
+                Solver solver(Expression(record.expression), record.word);
+                outcome.answer = solver.solve();
+            } else {
+                std::shared_ptr<const CompiledExpression> compiled = cache.get(record.expression);
+                validateWord(record.word);
+                outcome.answer = compiled->longestFactorOfValidWord(record.word);
+            }
+        } catch (ParseException e) {
+            outcome.failed = true;
+        }
+        outcome.latencyNanoseconds = static_cast<ulong>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - start).count());
+        return outcome;
+    }
+
+    void work(std::vector<Outcome> &outcomes) {
+        for (ulong i = nextRecord.fetch_add(1); i < records.size(); i = nextRecord.fetch_add(1)) {
+            outcomes[i] = solve(records[i]);
+        }
+    }
+
+public:
+    Replayer(const std::vector<TraceRecord> &records, ReplayEngine engine, ulong cacheBytes) :
+            records(records), engine(engine), cache(cacheBytes, nullptr), nextRecord(0) {}
+
+    // Запросы раздаются потокам по одному в порядке журнала
+    std::vector<Outcome> run(ulong threadCount) {
+        std::vector<Outcome> outcomes(records.size());
+        std::vector<std::thread> workers;
+        for (ulong i = 1; i < threadCount; ++i) {
+            workers.emplace_back(&Replayer::work, this, std::ref(outcomes));
+        }
+        work(outcomes);
+        for (std::thread &worker : workers) {
+            worker.join();
+        }
+        return outcomes;
+    }
+};
+
+struct Distribution {
+    ulong p50;
+    ulong p99;
+    ulong p999;
+    ulong maximum;
+};
+
+// Перцентили методом ближайшего ранга
+Distribution distribution(std::vector<ulong> latencies) {
+    if (latencies.empty()) {
+        return Distribution{0, 0, 0, 0};
+    }
+    std::sort(latencies.begin(), latencies.end());
+    auto percentile = [&](double fraction) {
+        ulong rank = static_cast<ulong>(fraction * latencies.size() + 0.999999);
+        return latencies[std::min(max(rank, 1UL), static_cast<ulong>(latencies.size())) - 1];
+    };
+    return Distribution{percentile(0.5), percentile(0.99), percentile(0.999), latencies.back()};
+}
+
+string describeAnswer(bool failed, ulong answer) {
+    return failed ? string("error") : std::to_string(answer);
+}
+
+// Длинные слова в отчёте обрезаются, кавычки и управляющие символы заменяются на '?'
+string shorten(string_view text) {
+    const ulong limit = 64;
+    string result(text.substr(0, limit));
+    for (char &character : result) {
+        if (character == '"' || character == '\\' || static_cast<unsigned char>(character) < 0x20) {
+            character = '?';
+        }
+    }
+    if (text.length() > limit) {
+        result += "...(" + std::to_string(text.length()) + ")";
+    }
+    return result;
+}
+
+void printDistribution(const char *name, const Distribution &value) {
+    std::printf("%-9s p50 %10.1f us  p99 %10.1f us  p999 %10.1f us  max %10.1f us\n", name, value.p50 / 1e3,
+                value.p99 / 1e3, value.p999 / 1e3, value.maximum / 1e3);
+}
+
+void printDistributionJson(const char *name, const Distribution &value) {
+    cout << "\"" << name << "\": {\"p50_ns\": " << value.p50 << ", \"p99_ns\": " << value.p99
+         << ", \"p999_ns\": " << value.p999 << ", \"max_ns\": " << value.maximum << "}";
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    string tracePath;
+    ulong threadCount = std::thread::hardware_concurrency();
+    ReplayEngine engine = REPLAY_RECORDED;
+    ulong cacheBytes = 64UL << 20;
+    ulong maxMismatches = 20;
+    bool json = false;
+
+    for (int i = 1; i < argc; ++i) {
+        string argument = argv[i];
+        if (argument == "--threads" && i + 1 < argc) {
+            threadCount = max(std::strtoul(argv[++i], nullptr, 10), 1UL);
+        } else if (argument == "--engine" && i + 1 < argc) {
+            string name = argv[++i];
+            if (name == "recorded") {
+                engine = REPLAY_RECORDED;
+            } else if (name == "automaton") {
+                engine = REPLAY_AUTOMATON;
+            } else if (name == "operand") {
+                engine = REPLAY_OPERAND;
+            } else {
+                std::cerr << "Unknown engine: " << name << endl;
+                return 1;
+            }
+        } else if (argument == "--cache-bytes" && i + 1 < argc) {
+            cacheBytes = std::strtoul(argv[++i], nullptr, 10);
+        } else if (argument == "--max-mismatches" && i + 1 < argc) {
+            maxMismatches = std::strtoul(argv[++i], nullptr, 10);
+        } else if (argument == "--json") {
+            json = true;
+        } else if (tracePath.empty() && argument.compare(0, 2, "--") != 0) {
+            tracePath = argument;
+        } else {
+            std::cerr << "Unknown argument: " << argument << endl;
+            return 1;
+        }
+    }
+    if (tracePath.empty()) {
+        std::cerr << "Usage: replay TRACE [--threads N] [--engine recorded|automaton|operand] [--json]" << endl;
+        return 1;
+    }
+
+    try {
+        TraceReader reader(tracePath);
+        std::vector<TraceRecord> records;
+        TraceRecord record;
+        while (reader.next(record)) {
+            records.push_back(record);
+        }
+
+        Replayer replayer(records, engine, cacheBytes);
+        auto start = std::chrono::steady_clock::now();
+        std::vector<Outcome> outcomes = replayer.run(threadCount);
+        double wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        std::vector<ulong> recordedLatencies, replayedLatencies;
+        std::vector<ulong> mismatches;
+        ulong errors = 0;
+        for (ulong i = 0; i < records.size(); ++i) {
+            recordedLatencies.push_back(records[i].latencyNanoseconds);
+            replayedLatencies.push_back(outcomes[i].latencyNanoseconds);
+            errors += outcomes[i].failed ? 1 : 0;
+            if (records[i].failed != outcomes[i].failed
+                || (!outcomes[i].failed && records[i].answer != outcomes[i].answer)) {
+                mismatches.push_back(i);
+            }
+        }
+        Distribution recorded = distribution(recordedLatencies);
+        Distribution replayed = distribution(replayedLatencies);
+        double throughput = wallSeconds > 0 ? records.size() / wallSeconds : 0;
+
+        if (json) {
+            cout << "{\"queries\": " << records.size() << ", \"errors\": " << errors << ", \"threads\": "
+                 << threadCount << ", \"wall_seconds\": " << wallSeconds << ", \"queries_per_second\": "
+                 << throughput << ", ";
+            printDistributionJson("recorded", recorded);
+            cout << ", ";
+            printDistributionJson("replayed", replayed);
+            cout << ", \"mismatch_count\": " << mismatches.size() << ", \"mismatches\": [";
+            for (ulong i = 0; i < mismatches.size() && i < maxMismatches; ++i) {
+                const TraceRecord &mismatched = records[mismatches[i]];
+                cout << (i > 0 ? ", " : "") << "{\"index\": " << mismatches[i] << ", \"expression\": \""
+                     << shorten(mismatched.expression) << "\", \"word\": \"" << shorten(mismatched.word)
+                     << "\", \"engine\": \"" << traceEngineName(mismatched.engine) << "\", \"recorded\": \""
+                     << describeAnswer(mismatched.failed, mismatched.answer) << "\", \"replayed\": \""
+                     << describeAnswer(outcomes[mismatches[i]].failed, outcomes[mismatches[i]].answer) << "\"}";
+            }
+            cout << "]}" << endl;
+        } else {
+            std::printf("queries %lu  errors %lu  threads %lu  wall %.3f s  %.0f queries/s\n",
+                        static_cast<ulong>(records.size()), errors, threadCount, wallSeconds, throughput);
+            printDistribution("recorded", recorded);
+            printDistribution("replayed", replayed);
+            std::printf("mismatches %lu\n", static_cast<ulong>(mismatches.size()));
+            for (ulong i = 0; i < mismatches.size() && i < maxMismatches; ++i) {
+                const TraceRecord &mismatched = records[mismatches[i]];
+                std::printf("MISMATCH #%lu %s %s (%s): recorded %s, replayed %s\n", mismatches[i],
+                            shorten(mismatched.expression).c_str(), shorten(mismatched.word).c_str(),
+                            traceEngineName(mismatched.engine),
+                            describeAnswer(mismatched.failed, mismatched.answer).c_str(),
+                            describeAnswer(outcomes[mismatches[i]].failed, outcomes[mismatches[i]].answer).c_str());
+            }
+        }
+        return mismatches.empty() ? 0 : 2;
+    } catch (ParseException e) {
+        std::cerr << e.what() << endl;
+        return 1;
+    }
+}
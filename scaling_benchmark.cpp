@@ -0,0 +1,314 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "operand.h"
+#include "automaton.h"
+#include "workload.h"
+
+// Сквозной замер масштабирования: запросы из примеров README, случайные выражения из
+// WorkloadGenerator и тяжёлые формы вроде (a*)* решаются каждым движком при растущей длине
+// слова n и растущем размере выражения; по точкам методом наименьших квадратов в логарифмах
+// оценивается показатель роста. Результат можно сохранить как эталон и сравнивать с ним:
+// scaling_benchmark [--engines operand,automaton] [--seed S] [--point-budget SECONDS]
+//                   [--save-baseline FILE] [--baseline FILE [--tolerance T]] [--json]
+
+namespace {
+
+// Время ответа на один запрос (вместе с разбором выражения) в секундах
+typedef std::function<double(const string &, const string &, double)> Engine;
+
+template <typename Query>
+double timeRepeated(Query query, double minSeconds) {
+    ulong iterations = 0;
+    auto start = std::chrono::steady_clock::now();
+    double elapsed = 0;
+    while (iterations == 0 || elapsed < minSeconds) {
+        query();
+        ++iterations;
+        elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+    return elapsed / iterations;
+}
+
+double timeOperand(const string &expression, const string &word, double minSeconds) {
+    return timeRepeated([&] {
+        Solver solver(Expression(expression), word);
+        solver.solve();
+    }, minSeconds);
+}
+
+double timeAutomaton(const string &expression, const string &word, double minSeconds) {
+    return timeRepeated([&] {
+        CompiledExpression compiled(expression);
+        compiled.longestFactor(word);
+    }, minSeconds);
+}
+
+struct Series {
+    string name;
+    std::vector<std::pair<ulong, double> > points; // (размер, секунды на запрос)
+    double exponent;
+};
+
+// Наклон прямой log(время) от log(размер); точки быстрее микросекунды слишком шумные
+double fitExponent(const std::vector<std::pair<ulong, double> > &points) {
+    double sumX = 0, sumY = 0, sumXX = 0, sumXY = 0;
+    ulong count = 0;
+    for (const auto &point : points) {
+        if (point.second < 1e-6) {
+            continue;
+        }
+        double x = std::log(static_cast<double>(point.first));
+        double y = std::log(point.second);
+        sumX += x;
+        sumY += y;
+        sumXX += x * x;
+        sumXY += x * y;
+        ++count;
+    }
+    double denominator = count * sumXX - sumX * sumX;
+    if (count < 2 || denominator <= 0) {
+        return NAN;
+    }
+    return (count * sumXY - sumX * sumY) / denominator;
+}
+
+// Каждая серия получает свой генератор, зависящий только от seed и имени серии, поэтому
+// нагрузка серии не меняется от того, какие ещё движки и серии запущены
+struct Runner {
+    ulong seed;
+    double pointBudget;
+    double minSeconds;
+    std::vector<Series> results;
+
+    Runner(ulong seed, double pointBudget) : seed(seed), pointBudget(pointBudget), minSeconds(0.02) {}
+
+    // Длины слова растут, пока один запрос укладывается в pointBudget
+    void sweepWordLength(const string &name, const Engine &engine, const string &expression,
+                         const std::vector<ulong> &lengths) {
+        Series series{name + "/n", {}, NAN};
+        WorkloadGenerator generator(seed ^ fnv1aHash(series.name));
+        for (ulong length : lengths) {
+            double seconds = engine(expression, generator.word(length), minSeconds);
+            series.points.emplace_back(length, seconds);
+            if (seconds > pointBudget) {
+                break;
+            }
+        }
+        series.exponent = fitExponent(series.points);
+        results.push_back(series);
+    }
+
+    // Число листьев случайного выражения растёт при фиксированной длине слова
+    void sweepExpressionSize(const string &name, const Engine &engine, ulong wordLength,
+                             const std::vector<ulong> &leafCounts) {
+        Series series{name + "/regex", {}, NAN};
+        WorkloadGenerator generator(seed ^ fnv1aHash(series.name));
+        string word = generator.word(wordLength);
+        for (ulong leafCount : leafCounts) {
+            double seconds = engine(generator.expression(leafCount, 2), word, minSeconds);
+            series.points.emplace_back(leafCount, seconds);
+            if (seconds > pointBudget) {
+                break;
+            }
+        }
+        series.exponent = fitExponent(series.points);
+        results.push_back(series);
+    }
+};
+
+std::vector<ulong> geometric(ulong from, ulong to, double ratio) {
+    std::vector<ulong> values;
+    for (double value = static_cast<double>(from); value <= static_cast<double>(to) + 0.5; value *= ratio) {
+        ulong rounded = static_cast<ulong>(value + 0.5);
+        if (values.empty() || values.back() != rounded) {
+            values.push_back(rounded);
+        }
+    }
+    return values;
+}
+
+// Эталон: строки "series exponent E" и "series point SIZE SECONDS"
+struct Baseline {
+    std::map<string, double> exponents;
+    std::map<std::pair<string, ulong>, double> points;
+
+    static Baseline read(const string &path) {
+        Baseline baseline;
+        std::ifstream input(path);
+        if (!input) {
+            throw ParseException("Cannot open baseline " + path);
+        }
+        string line;
+        while (std::getline(input, line)) {
+            std::istringstream fields(line);
+            string name, kind;
+            fields >> name >> kind;
+            if (kind == "exponent") {
+                fields >> baseline.exponents[name];
+            } else if (kind == "point") {
+                ulong size;
+                double seconds;
+                fields >> size >> seconds;
+                baseline.points[std::make_pair(name, size)] = seconds;
+            }
+        }
+        return baseline;
+    }
+
+    static void write(const string &path, const std::vector<Series> &results) {
+        std::ofstream output(path);
+        for (const Series &series : results) {
+            if (!std::isnan(series.exponent)) {
+                output << series.name << " exponent " << series.exponent << "\n";
+            }
+            for (const auto &point : series.points) {
+                output << series.name << " point " << point.first << " " << point.second << "\n";
+            }
+        }
+    }
+};
+
+// Регрессии относительно эталона: замедление точки больше чем в (1 + tolerance) раз
+// или рост показателя больше чем на 0.25
+std::vector<string> findRegressions(const Baseline &baseline, const std::vector<Series> &results, double tolerance) {
+    std::vector<string> regressions;
+    for (const Series &series : results) {
+        auto exponent = baseline.exponents.find(series.name);
+        if (exponent != baseline.exponents.end() && !std::isnan(series.exponent) && !std::isnan(exponent->second)
+            && series.exponent > exponent->second + 0.25) {
+            regressions.push_back(series.name + ": exponent " + std::to_string(exponent->second) + " -> "
+                                  + std::to_string(series.exponent));
+        }
+        for (const auto &point : series.points) {
+            auto stored = baseline.points.find(std::make_pair(series.name, point.first));
+            if (stored != baseline.points.end() && stored->second >= 1e-6
+                && point.second > stored->second * (1 + tolerance)) {
+                regressions.push_back(series.name + " at " + std::to_string(point.first) + ": "
+                                      + std::to_string(stored->second) + "s -> " + std::to_string(point.second) + "s");
+            }
+        }
+    }
+    return regressions;
+}
+
+void printResults(const std::vector<Series> &results, const std::vector<string> &regressions, bool json) {
+    if (!json) {
+        for (const Series &series : results) {
+            std::printf("%-36s exponent %6.2f  largest %8lu  %12.6f s\n", series.name.c_str(), series.exponent,
+                        series.points.back().first, series.points.back().second);
+        }
+        for (const string &regression : regressions) {
+            std::printf("REGRESSION %s\n", regression.c_str());
+        }
+        return;
+    }
+
+    cout << "{\"series\": [\n";
+    for (ulong i = 0; i < results.size(); ++i) {
+        const Series &series = results[i];
+        cout << "  {\"name\": \"" << series.name << "\", \"exponent\": ";
+        if (std::isnan(series.exponent)) {
+            cout << "null";
+        } else {
+            cout << series.exponent;
+        }
+        cout << ", \"points\": [";
+        for (ulong j = 0; j < series.points.size(); ++j) {
+            cout << (j > 0 ? ", " : "") << "[" << series.points[j].first << ", " << series.points[j].second << "]";
+        }
+        cout << "]}" << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    cout << "], \"regressions\": [";
+    for (ulong i = 0; i < regressions.size(); ++i) {
+        cout << (i > 0 ? ", " : "") << "\"" << regressions[i] << "\"";
+    }
+    cout << "]}" << endl;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    string engineList = "operand,automaton";
+    ulong seed = 2024;
+    double pointBudget = 1.0;
+    double tolerance = 0.25;
+    string baselinePath;
+    string saveBaselinePath;
+    bool json = false;
+
+    for (int i = 1; i < argc; ++i) {
+        string argument = argv[i];
+        if (argument == "--engines" && i + 1 < argc) {
+            engineList = argv[++i];
+        } else if (argument == "--seed" && i + 1 < argc) {
+            seed = std::strtoul(argv[++i], nullptr, 10);
+        } else if (argument == "--point-budget" && i + 1 < argc) {
+            pointBudget = std::atof(argv[++i]);
+        } else if (argument == "--baseline" && i + 1 < argc) {
+            baselinePath = argv[++i];
+        } else if (argument == "--save-baseline" && i + 1 < argc) {
+            saveBaselinePath = argv[++i];
+        } else if (argument == "--tolerance" && i + 1 < argc) {
+            tolerance = std::atof(argv[++i]);
+        } else if (argument == "--json") {
+            json = true;
+        } else {
+            std::cerr << "Unknown argument: " << argument << endl;
+            return 1;
+        }
+    }
+
+    std::vector<std::pair<string, string> > expressions;
+    std::vector<string> readme = WorkloadGenerator::readmeExpressions();
+    for (ulong i = 0; i < readme.size(); ++i) {
+        expressions.emplace_back("readme" + std::to_string(i), readme[i]);
+    }
+    expressions.emplace_back("random16", WorkloadGenerator(seed).expression(16, 2));
+    expressions.emplace_back("nested_stars", WorkloadGenerator::nestedStars(4));
+    expressions.emplace_back("star_concatenation", WorkloadGenerator::starConcatenation(8));
+    expressions.emplace_back("nested_union_stars", WorkloadGenerator::nestedUnionStars(3));
+
+    Runner runner(seed, pointBudget);
+
+    try {
+        if (engineList.find("operand") != string::npos) {
+            for (const auto &expression : expressions) {
+                runner.sweepWordLength("operand/" + expression.first, timeOperand, expression.second,
+                                       geometric(2, 64, 1.5));
+            }
+            runner.sweepExpressionSize("operand/random", timeOperand, 8, geometric(2, 256, 2));
+        }
+        if (engineList.find("automaton") != string::npos) {
+            for (const auto &expression : expressions) {
+                runner.sweepWordLength("automaton/" + expression.first, timeAutomaton, expression.second,
+                                       geometric(256, 1 << 20, 4));
+            }
+            runner.sweepExpressionSize("automaton/random", timeAutomaton, 4096, geometric(4, 4096, 2));
+        }
+
+        std::vector<string> regressions;
+        if (!baselinePath.empty()) {
+            regressions = findRegressions(Baseline::read(baselinePath), runner.results, tolerance);
+        }
+        if (!saveBaselinePath.empty()) {
+            Baseline::write(saveBaselinePath, runner.results);
+        }
+
+        printResults(runner.results, regressions, json);
+        return regressions.empty() ? 0 : 2;
+    } catch (ParseException e) {
+        std::cerr << e.what() << endl;
+        return 1;
+    }
+}
@@ -0,0 +1,146 @@
+#ifndef FORMAL_LANGUAGE_SEMIRING_H
+#define FORMAL_LANGUAGE_SEMIRING_H
+
+// Полукольца весов для BasicOperand (operand.h). plus складывает веса альтернатив (ветви
+// объединения, разные разбиения подслова), times -- веса последовательных частей одного вывода;
+// zero -- вес отсутствующего вывода, one -- вес пустого. Операции статические, так что ядра
+// BasicOperand инстанцируются под каждое полукольцо без косвенных вызовов. Для BooleanSemiring
+// есть специализация Operand с разреженными таблицами и строками-битсетами
+
+#include <algorithm>
+#include <climits>
+
+#include "common.h"
+
+struct BooleanSemiring {
+    typedef unsigned char Value;
+
+    static const char *name() {
+        return "boolean";
+    }
+
+    static Value zero() {
+        return 0;
+    }
+
+    static Value one() {
+        return 1;
+    }
+
+    static Value plus(Value first, Value second) {
+        return first | second;
+    }
+
+    static Value times(Value first, Value second) {
+        return first & second;
+    }
+
+    static string render(Value value) {
+        return value ? "true" : "false";
+    }
+};
+
+// Число выводов; при переполнении значение остаётся ULONG_MAX
+struct CountingSemiring {
+    typedef ulong Value;
+
+    static const char *name() {
+        return "count";
+    }
+
+    static Value zero() {
+        return 0;
+    }
+
+    static Value one() {
+        return 1;
+    }
+
+    static Value plus(Value first, Value second) {
+        Value sum;
+        return __builtin_add_overflow(first, second, &sum) ? ULONG_MAX : sum;
+    }
+
+    static Value times(Value first, Value second) {
+        Value product;
+        return __builtin_mul_overflow(first, second, &product) ? ULONG_MAX : product;
+    }
+
+    static string render(Value value) {
+        return (value == ULONG_MAX ? ">=" : "") + std::to_string(value);
+    }
+};
+
+// Наименьшая стоимость вывода (min, +); zero -- бесконечная стоимость LONG_MAX
+struct MinCostSemiring {
+    typedef long Value;
+
+    static const char *name() {
+        return "min-cost";
+    }
+
+    static Value zero() {
+        return LONG_MAX;
+    }
+
+    static Value one() {
+        return 0;
+    }
+
+    static Value plus(Value first, Value second) {
+        return std::min(first, second);
+    }
+
+    static Value times(Value first, Value second) {
+        Value sum;
+        if (first == zero() || second == zero()) {
+            return zero();
+        }
+        if (__builtin_add_overflow(first, second, &sum)) {
+            return first > 0 ? zero() : LONG_MIN;
+        }
+        return sum;
+    }
+
+    static string render(Value value) {
+        return value == zero() ? "inf" : std::to_string(value);
+    }
+};
+
+// Наибольшая стоимость вывода (max, +); zero -- LONG_MIN
+struct MaxCostSemiring {
+    typedef long Value;
+
+    static const char *name() {
+        return "max-cost";
+    }
+
+    static Value zero() {
+        return LONG_MIN;
+    }
+
+    static Value one() {
+        return 0;
+    }
+
+    static Value plus(Value first, Value second) {
+        return std::max(first, second);
+    }
+
+    static Value times(Value first, Value second) {
+        Value sum;
+        if (first == zero() || second == zero()) {
+            return zero();
+        }
+        if (__builtin_add_overflow(first, second, &sum)) {
+            return first > 0 ? LONG_MAX : LONG_MIN + 1;
+        }
+        return sum == zero() ? LONG_MIN + 1 : sum;
+    }
+
+    static string render(Value value) {
+        return value == zero() ? "-inf" : std::to_string(value);
+    }
+};
+
+#endif // FORMAL_LANGUAGE_SEMIRING_H
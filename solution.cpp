@@ -1,430 +1,813 @@
 #include <iostream>
+#include <algorithm>
 #include <vector>
 #include <string>
-#include <stack>
-#include <cassert>
-#include <set>
-#include <cstdio>
-
-using std::cin;
-using std::cout;
-using std::endl;
-using std::max;
-using std::string;
-
-typedef unsigned long ulong;
-
-const char EPSILON = '1';
-
-struct ParseException : public std::logic_error {
-    ParseException(const string & message) : std::logic_error(message) {}
-};
-
-enum OperatorType {
-    PLUS,
-    MULTIPLY,
-    KLEENE_STAR
-};
-
-// Структура, описывающая язык L(Operand), соответствующий
-// какому-то регулярному выражению, который является
-// операндом исходного регулярного выражения
-struct Operand {
-private:
-
-    std::vector<std::vector<int> > containsSubstring;
-    // containsSubstring[i][j] == true <=> подслово (данного слова) длины j,
-    // начинающееся в i-ой позиции, содержится в нашем языке L(Operand)
-
-    bool containsEpsilon;
-    // containsEpsilon == true <=> пустое слово принадлежит нашему языку L(Operand)
-
-    bool containsWordAsSubstring;
-    // containsWordAsSubstring == true <=> данное слово word содержится
-    // в качестве подслова какого-либо слова v из языка L(Operand)
-
-    std::vector<int> containsSuffixEqualsToPrefix;
-    // containsSuffixEqualsToPrefix[length] == true <=> есть в языке L(Operand) слово v, такое,
-    // что суффикс u слова v является префиксом длины length данного слова word
-
-    std::vector<int> containsPrefixEqualsToSuffix;
-    // containsPrefixEqualsToSuffix[length] == true <=> есть в языке L(Operand) cлово v, такое,
-    // что префикс u слова v является суффиксом длины length данного слова word
-
-    ulong wordLength;
-    // длина данного слова word
-
-    void updateContainsWordAsSubstringForMultiply(Operand &result, const Operand &left, const Operand &right) const {
-        result.containsWordAsSubstring = left.containsWordAsSubstring || right.containsWordAsSubstring;
-
-        // L1 ~ left; L2 ~ right; L1.L2 ~ result
-
-        // word = CCCCCTTTT
-        //        ^^^^^      - prefix
-        //             ^^^^  - suffix
-
-        // L1: XXXXXCCCCC             L2: TTTTYYYYYY    ->   L1.L2:   XXXXXCCCCCTTTTYYYYYY
-        //          ^^^^^                 ^^^^                             ^^^^^^^^^
-        //       suffix equals        prefix equals             word contains as substring in new language
-        //         to prefix            to suffix
+#include <memory>
+#include <thread>
+#include <chrono>
+#include <fstream>
+#include <unordered_map>
+#include <cstdlib>
+#include <climits>
+#include <cerrno>
+#include <cstring>
+#include <csignal>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/prctl.h>
+
+#include "common.h"
+#include "input.h"
+#include "operand.h"
+#include "automaton.h"
+#include "storage.h"
+#include "pipeline.h"
+#include "trace.h"
+#include "metrics.h"
+#include "planner.h"
+#include "tuning.h"
+#include "weighted_operand.h"
+#include "approximate.h"
+#include "formal_language.h"
+
+// Значение опции name вида "name VALUE" или пустая строка
+string optionArgument(const std::vector<string> &arguments, const string &name) {
+    for (ulong i = 0; i + 1 < arguments.size(); ++i) {
+        if (arguments[i] == name) {
+            return arguments[i + 1];
+        }
+    }
+    return string();
+}
+
+// Есть ли среди аргументов флаг name
+bool flagArgument(const std::vector<string> &arguments, const string &name) {
+    return std::find(arguments.begin(), arguments.end(), name) != arguments.end();
+}
+
+// Число потоков вычисления из аргумента --threads N или число ядер
+ulong threadCountArgument(const std::vector<string> &arguments) {
+    string threads = optionArgument(arguments, "--threads");
+    if (!threads.empty()) {
+        return std::strtoul(threads.c_str(), nullptr, 10);
+    }
+    return std::thread::hardware_concurrency();
+}
 
-        for (ulong prefixLength = 1; prefixLength < wordLength; ++prefixLength) {
-            ulong suffixLength = wordLength - prefixLength;
-            assert(suffixLength > 0 && suffixLength < wordLength);
+const ulong DEFAULT_RESULT_CACHE_BYTES = 64UL << 20;
 
-            result.containsWordAsSubstring |=
-                    left.containsSuffixEqualsToPrefix[prefixLength]
-                    && right.containsPrefixEqualsToSuffix[suffixLength];
+// Постоянный кэш ответов из аргументов --result-cache FILE [--result-cache-bytes B] или nullptr
+std::unique_ptr<ResultCache> resultCacheArgument(const std::vector<string> &arguments) {
+    string path = optionArgument(arguments, "--result-cache");
+    if (path.empty()) {
+        return nullptr;
+    }
+    string bytes = optionArgument(arguments, "--result-cache-bytes");
+    return std::unique_ptr<ResultCache>(new ResultCache(
+            path, bytes.empty() ? DEFAULT_RESULT_CACHE_BYTES : std::strtoul(bytes.c_str(), nullptr, 10)));
+}
+
+// Журнал запросов из аргумента --trace FILE или nullptr
+std::unique_ptr<TraceWriter> traceArgument(const std::vector<string> &arguments) {
+    string path = optionArgument(arguments, "--trace");
+    if (path.empty()) {
+        return nullptr;
+    }
+    return std::unique_ptr<TraceWriter>(new TraceWriter(path));
+}
+
+// Параметры движков из --tuning FILE или из переменной окружения FORMAL_LANGUAGE_TUNING
+void installTuningArgument(const std::vector<string> &arguments) {
+    string path = optionArgument(arguments, "--tuning");
+    if (path.empty() && std::getenv("FORMAL_LANGUAGE_TUNING") != nullptr) {
+        path = std::getenv("FORMAL_LANGUAGE_TUNING");
+    }
+    if (!path.empty()) {
+        TuningConfig::install(TuningConfig::load(path));
+    }
+}
+
+// Вес самых длинных подходящих подслов в полукольце Semiring со стоимостями листьев из
+// --leaf-costs C1,C2,... (по умолчанию каждый лист стоит 1)
+template <typename Semiring>
+string weighFactors(string_view expression, string_view word, ulong answer, const string &leafCosts) {
+    std::vector<typename Semiring::Value> leafWeights;
+    if (leafCosts.empty()) {
+        leafWeights.assign(ExpressionShape(expression).leaves, 1);
+    }
+    for (ulong start = 0; start < leafCosts.length();) {
+        ulong end = std::min(leafCosts.find(',', start), leafCosts.length());
+        string cost = leafCosts.substr(start, end - start);
+        char *parsedEnd = nullptr;
+        leafWeights.push_back(std::strtol(cost.c_str(), &parsedEnd, 10));
+        if (cost.empty() || *parsedEnd != '\0') {
+            throw ParseException("Invalid leaf cost: " + cost);
         }
+        start = end + 1;
+    }
+    return Semiring::render(WeightedSolver<Semiring>(expression, word, leafWeights).weighFactors(answer));
+}
 
-        // word == CCCCTTTTYYY
-        //         ^^^^^^^^    - prefix with prefixLength
-        //         ^^^^        - subPrefix with subPrefixLength
-        //             ^^^^    - suffixOfPrefix with suffixOfPrefixLength
-
-        // L1: XXCCCC  L2: TTTT            ->      L1.L2:  XXCCCCTTTT
-        //       ^^^^      ^^^^                              ^^^^^^^^
-        //    subPrefix   suffixOfPrefix               new suffix equals to prefix
+// Движок плана в терминах библиотеки
+formal_language::Engine libraryEngine(PlanEngine engine) {
+    if (engine == ENGINE_OPERAND) {
+        return formal_language::Engine::Operand;
+    }
+    return engine == ENGINE_FINITE ? formal_language::Engine::Finite : formal_language::Engine::Automaton;
+}
+
+// Столбец веса для --weights count|min-cost|max-cost: число выводов самых длинных подходящих
+// подслов или их наименьшая или наибольшая стоимость; без --weights -- пустая строка
+string weightsColumn(const string &weights, const string &leafCosts, string_view expression, string_view word,
+                     ulong answer) {
+    if (weights == CountingSemiring::name()) {
+        return " " + CountingSemiring::render(WeightedSolver<CountingSemiring>(expression, word).weighFactors(answer));
+    }
+    if (weights == MinCostSemiring::name()) {
+        return " " + weighFactors<MinCostSemiring>(expression, word, answer, leafCosts);
+    }
+    if (weights == MaxCostSemiring::name()) {
+        return " " + weighFactors<MaxCostSemiring>(expression, word, answer, leafCosts);
+    }
+    return "";
+}
+
+// Имя входного файла: первый аргумент, не являющийся опцией, или стандартный вход
+string inputPathArgument(const std::vector<string> &arguments) {
+    for (ulong i = 1; i < arguments.size(); ++i) {
+        if (arguments[i].compare(0, 2, "--") == 0) {
+            ++i;
+        } else {
+            return arguments[i];
+        }
+    }
+    return "/dev/stdin";
+}
+
+// Пакетный режим: --batch [FILE] [--threads N] [--artifact COMPILED] [--trace TRACE]
+// Первое слово входа -- выражение, остальные -- слова; на каждое слово печатается строка ответа.
+// С --artifact выражение загружается из файла, записанного --compile, и все слова входа -- слова
+int runBatch(const std::vector<string> &arguments) {
+    MappedInput input(inputPathArgument(arguments).c_str());
+    string artifactPath = optionArgument(arguments, "--artifact");
+    CompiledExpression expression = artifactPath.empty()
+                                    ? CompiledExpression(canonicalizeExpression(input.nextToken()))
+                                    : CompiledExpression::load(artifactPath);
+    std::unique_ptr<ResultCache> resultCache = resultCacheArgument(arguments);
+    std::unique_ptr<TraceWriter> trace = traceArgument(arguments);
+
+    PipelineExecutor executor(threadCountArgument(arguments), PIPELINE_QUEUE_CAPACITY, resultCache.get(),
+                              trace.get());
+    executor.run([&](PipelineExecutor::Query &query) {
+        query.word = input.nextToken();
+        if (query.word.empty()) {
+            return false;
+        }
+        try {
+            validateWord(query.word);
+            query.expression = &expression;
+        } catch (ParseException e) {
+            query.error = e.what();
+        }
+        return true;
+    }, cout);
 
-        for (ulong prefixLength = 1; prefixLength < wordLength; ++prefixLength) {
-            result.containsSuffixEqualsToPrefix[prefixLength] = right.containsSuffixEqualsToPrefix[prefixLength];
-            result.containsSuffixEqualsToPrefix[prefixLength] |=
-                    left.containsSuffixEqualsToPrefix[prefixLength] && right.containsEpsilon;
+    return 0;
+}
+
+// Пакетный режим: --pairs [FILE] [--threads N] [--artifact-dir DIR] [--trace TRACE]
+// Каждая строка входа -- пара "выражение слово"; каждое различное выражение компилируется один раз.
+// С --artifact-dir скомпилированные выражения берутся из общего каталога ArtifactStore
+int runPairs(const std::vector<string> &arguments) {
+    MappedInput input(inputPathArgument(arguments).c_str());
+    std::unordered_map<string, CompiledExpression> compiled;
+    string artifactDirectory = optionArgument(arguments, "--artifact-dir");
+    std::unique_ptr<ArtifactStore> store;
+    if (!artifactDirectory.empty()) {
+        store.reset(new ArtifactStore(artifactDirectory));
+    }
 
-            for (ulong subPrefixLength = 1; subPrefixLength < prefixLength; ++subPrefixLength) {
-                ulong suffixOfPrefixLength = prefixLength - subPrefixLength;
+    std::unique_ptr<ResultCache> resultCache = resultCacheArgument(arguments);
+    std::unique_ptr<TraceWriter> trace = traceArgument(arguments);
 
-                result.containsSuffixEqualsToPrefix[prefixLength] |=
-                        right.containsSubstring[subPrefixLength][suffixOfPrefixLength]
-                        && left.containsSuffixEqualsToPrefix[subPrefixLength];
+    PipelineExecutor executor(threadCountArgument(arguments), PIPELINE_QUEUE_CAPACITY, resultCache.get(),
+                              trace.get());
+    executor.run([&](PipelineExecutor::Query &query) {
+        string_view expressionText;
+        while (expressionText.empty() && query.word.empty()) {
+            if (input.finished()) {
+                return false;
             }
-
+            string_view line = input.nextLine();
+            expressionText = MappedInput::splitToken(line);
+            query.word = MappedInput::splitToken(line);
         }
 
-        // word == YYYYCCCCCCTTTT
-        //             ^^^^^^^^^^  - suffix
-        //                   ^^^^  - subSuffix
-        //             ^^^^^^      - prefix of suffix
-
-        // L1: CCCCCC         L2: TTTTXXXX       ->    L1.L2:   CCCCCCTTTTXXXX
-        //     ^^^^^^             ^^^^                          ^^^^^^^^^^
-        //  prefix of suffix     subSuffix                   new prefix equals to suffix
-
-        for (ulong suffixLength = 1; suffixLength < wordLength; ++suffixLength) {
-            result.containsPrefixEqualsToSuffix[suffixLength] = left.containsPrefixEqualsToSuffix[suffixLength];
-            result.containsPrefixEqualsToSuffix[suffixLength] |=
-                    left.containsEpsilon && right.containsPrefixEqualsToSuffix[suffixLength];
-
-            for (ulong subSuffixLength = 1; subSuffixLength < suffixLength; ++subSuffixLength) {
-                ulong prefixOfSuffixLength = suffixLength - subSuffixLength;
-
-                result.containsPrefixEqualsToSuffix[suffixLength] |=
-                        left.containsSubstring[wordLength - suffixLength][prefixOfSuffixLength]
-                        && right.containsPrefixEqualsToSuffix[subSuffixLength];
+        try {
+            auto found = compiled.find(string(expressionText));
+            if (found == compiled.end()) {
+                string canonical = canonicalizeExpression(expressionText);
+                found = compiled.emplace(string(expressionText),
+                                         store ? store->get(canonical) : CompiledExpression(canonical)).first;
             }
+            validateWord(query.word);
+            query.expression = &found->second;
+        } catch (ParseException e) {
+            query.error = e.what();
         }
+        return true;
+    }, cout);
 
-    }
-
-    void updateContainsSubstringForMultiply(Operand &result, const Operand &left, const Operand &right) const {
-        for (ulong startPosition = 0; startPosition < wordLength; ++startPosition) {
-            for (ulong length = 1; length <= wordLength - startPosition; ++length) {
-                for (ulong prefixLength = 0; prefixLength <= length; ++prefixLength) {
-
-                    ulong suffixLength = length - prefixLength;
-
-                    prefixLength++;
-                    prefixLength--;
-
-                    if (prefixLength == 0) {
-                        if (left.containsEpsilon) {
-                            result.containsSubstring[startPosition][length] |=
-                                    right.containsSubstring[startPosition][length];
-                        }
-                        continue;
-                    }
-
-                    if (suffixLength == 0) {
-                        if (right.containsEpsilon) {
-                            result.containsSubstring[startPosition][length] |=
-                                    left.containsSubstring[startPosition][length];
-                        }
-                        continue;
-                    }
+    return 0;
+}
 
-                    result.containsSubstring[startPosition][length] |=
-                            left.containsSubstring[startPosition][prefixLength] &&
-                            right.containsSubstring[startPosition + prefixLength][suffixLength];
+// Сервер запросов. Протокол строковый: запрос "EXPRESSION WORD" -- ответ с длиной
+// подслова или сообщением об ошибке; запрос "STATS" -- статистика кэша выражений;
+// запрос "METRICS" -- метрики в формате Prometheus, завершённые строкой "# EOF"
+struct QueryServer {
+private:
+    CompileCache cache;
+    std::unique_ptr<ResultCache> resultCache;
+    std::shared_ptr<TraceWriter> trace;
+    ServerMetrics &metrics;
+    WorkerPool pool;
+
+    // Движок выбирает QueryPlan, как в основном режиме. Выражение уже скомпилировано кэшем,
+    // поэтому конечный язык отвечает тем же автоматом позиций; у Operand учитываются итерации
+    // звёздочки и байты выделенных таблиц
+    ulong solve(const CompiledExpression &compiled, string_view word, TraceEngine &engine) {
+        QueryPlan plan(compiled.getExpression(), word.length());
+        if (plan.getEngine() != ENGINE_OPERAND) {
+            engine = TRACE_AUTOMATON;
+            return compiled.longestFactorOfValidWord(word);
+        }
+        engine = TRACE_OPERAND;
+        Solver solver(Expression(compiled.getExpression()), word);
+        ulong answer = solver.solve();
+        metrics.recordOperandWork(solver.getStarIterations(), solver.getMemoryStatistics().allocatedBytes);
+        return answer;
+    }
 
+    ulong evaluate(string_view expression, string_view word, TraceEngine &engine) {
+        bool hit;
+        std::shared_ptr<const CompiledExpression> compiled = cache.get(expression, &hit);
+        metrics.recordCompileCache(hit);
+        validateWord(word);
+        if (!resultCache) {
+            return solve(*compiled, word, engine);
+        }
 
-                    // Слово W длины length лежит в языке (L1 . L2), если найдется
-                    // такой префикс длины sublength слова W, что этот префикс
-                    // принадлежит языку L1, и при этом языку L2 принадлежит
-                    // суффикс длины (length - sublegth) слова W
+        ResultCache::Key key = ResultCache::makeKey(compiled->getExpression(), word);
+        ulong answer;
+        if (resultCache->lookup(key, answer)) {
+            engine = TRACE_RESULT_CACHE;
+        } else {
+            answer = solve(*compiled, word, engine);
+            resultCache->store(key, answer);
+        }
+        return answer;
+    }
 
-                }
+    string answer(string_view line) {
+        string_view first = MappedInput::splitToken(line);
+        string_view second = MappedInput::splitToken(line);
+
+        if (first == "STATS" && second.empty()) {
+            CompileCache::Statistics statistics = cache.getStatistics();
+            ulong lookups = statistics.hits + statistics.misses;
+            double hitRate = lookups == 0 ? 0.0 : static_cast<double>(statistics.hits) / lookups;
+            string reply = "hits " + std::to_string(statistics.hits) + " misses " + std::to_string(statistics.misses)
+                           + " evictions " + std::to_string(statistics.evictions)
+                           + " entries " + std::to_string(statistics.entries)
+                           + " bytes " + std::to_string(statistics.bytes) + " hit_rate " + std::to_string(hitRate);
+            if (resultCache) {
+                reply += " result_hits " + std::to_string(resultCache->getHits())
+                         + " result_misses " + std::to_string(resultCache->getMisses());
             }
+            return reply + "\n";
+        }
+        if (first == "METRICS" && second.empty()) {
+            return metrics.render() + "# EOF\n";
         }
 
-        result.containsEpsilon = left.containsEpsilon && right.containsEpsilon;
+        auto start = std::chrono::steady_clock::now();
+        TraceEngine engine = TRACE_AUTOMATON;
+        try {
+            ulong length = evaluate(first, second, engine);
+            auto latency = std::chrono::steady_clock::now() - start;
+            metrics.recordQuery(engine, latency);
+            if (trace) {
+                trace->record(engine, latency, false, length, first, second);
+            }
+            return std::to_string(length) + "\n";
+        } catch (ParseException e) {
+            auto latency = std::chrono::steady_clock::now() - start;
+            metrics.recordRejected(e.what(), latency);
+            if (trace) {
+                trace->record(engine, latency, true, 0, first, second);
+            }
+            return string(e.what()) + "\n";
+        }
     }
 
 public:
-
-    // Операнд, задающий язык из одного символа
-    Operand(char character, const string &word) {
-        containsSubstring = std::vector<std::vector<int> >(word.length() + 1, std::vector<int>(word.length() + 1, 0));
-        containsPrefixEqualsToSuffix.clear();
-        containsPrefixEqualsToSuffix.resize(word.length() + 1);
-        containsSuffixEqualsToPrefix.clear();
-        containsSuffixEqualsToPrefix.resize(word.length() + 1);
-        wordLength = word.length();
-
-        if (character == EPSILON) {
-            containsEpsilon = true;
-            containsWordAsSubstring = false;
-        } else {
-            containsEpsilon = false;
-
-            if (word.length() == 1) {
-                containsWordAsSubstring = word[0] == character;
-            } else {
-                containsWordAsSubstring = false;
+    // Если trace задан, в него записываются все запросы, кроме STATS
+    QueryServer(ulong threadCount, ulong cacheBytes, std::shared_ptr<const ArtifactStore> store,
+                std::unique_ptr<ResultCache> resultCache, std::shared_ptr<TraceWriter> trace, ServerMetrics &metrics) :
+            cache(cacheBytes, store), resultCache(std::move(resultCache)), trace(std::move(trace)), metrics(metrics),
+            pool(threadCount) {}
+
+    // Обслуживает одно соединение до его закрытия: запросы читаются построчно, ответы
+    // пишутся в том же порядке
+    void serveConnection(int inputFd, int outputFd) {
+        string pending;
+        char block[1 << 12];
+
+        while (true) {
+            ssize_t bytesRead = read(inputFd, block, sizeof(block));
+            if (bytesRead < 0 && errno == EINTR) {
+                continue;
             }
-
-            if (word[0] == character) {
-                containsSuffixEqualsToPrefix[1] = true;
+            if (bytesRead <= 0) {
+                break;
             }
-
-            if (word.back() == character) {
-                containsPrefixEqualsToSuffix[1] = true;
+            pending.append(block, static_cast<ulong>(bytesRead));
+
+            string replies;
+            ulong lineBegin = 0;
+            for (ulong lineEnd = pending.find('\n'); lineEnd != string::npos;
+                 lineEnd = pending.find('\n', lineBegin)) {
+                replies += answer(string_view(pending).substr(lineBegin, lineEnd - lineBegin));
+                lineBegin = lineEnd + 1;
             }
+            pending.erase(0, lineBegin);
 
-            for (ulong startPosition = 0; startPosition < wordLength; ++startPosition) {
-                if (character == word[startPosition]) {
-                    containsSubstring[startPosition][1] = true;
-                }
+            if (!writeAll(outputFd, replies)) {
+                break;
             }
         }
+        if (!pending.empty()) {
+            writeAll(outputFd, answer(pending));
+        }
+        // процессы сервера завершаются без деструкторов, поэтому журнал сбрасывается
+        // после каждого соединения
+        if (trace) {
+            trace->flush();
+        }
     }
 
-    // Операнд, задающий пустой язык
-    Operand(ulong wordLength) : containsSubstring(wordLength + 1, std::vector<int>(wordLength + 1, 0)),
-                                containsEpsilon(false), containsWordAsSubstring(false),
-                                containsSuffixEqualsToPrefix(wordLength + 1),
-                                containsPrefixEqualsToSuffix(wordLength + 1),
-                                wordLength(wordLength) {}
-
-    Operand() {}
-
-    bool isWordEqualToSomeSubstringInLanguage() const {
-        return containsWordAsSubstring;
-    }
-
-    Operand operator+(const Operand &right) const {
-        Operand left = *this;
-
-        for (ulong startPosition = 0; startPosition < wordLength; ++startPosition) {
-            for (ulong length = 0; length <= wordLength - startPosition; ++length) {
-                left.containsSubstring[startPosition][length] |= right.containsSubstring[startPosition][length];
+    // Принимает соединения на слушающем сокете; каждое соединение обслуживается в пуле потоков
+    int acceptConnections(int listener) {
+        while (true) {
+            int connection = accept(listener, nullptr, nullptr);
+            if (connection < 0) {
+                if (errno == EINTR || errno == ECONNABORTED) {
+                    continue;
+                }
+                std::cerr << "Accept error: " << std::strerror(errno) << endl;
+                break;
             }
+            pool.submit([this, connection] {
+                serveConnection(connection, connection);
+                close(connection);
+            });
         }
 
-        for (ulong length = 1; length <= wordLength; ++length) {
-            left.containsSuffixEqualsToPrefix[length] |= right.containsSuffixEqualsToPrefix[length];
-            left.containsPrefixEqualsToSuffix[length] |= right.containsPrefixEqualsToSuffix[length];
-        }
-
-        left.containsEpsilon |= right.containsEpsilon;
-        left.containsWordAsSubstring |= right.containsWordAsSubstring;
-
-        assert(left.wordLength == right.wordLength);
-
-        return left;
+        close(listener);
+        return 1;
     }
+};
 
-    Operand operator*(const Operand &right) const {
-        Operand left = *this;
-        Operand result(wordLength);
-
-        updateContainsSubstringForMultiply(result, left, right);
-
-        updateContainsWordAsSubstringForMultiply(result, left, right);
-
-        return result;
+// Слушающий Unix-сокет по пути socketPath или -1 при ошибке
+int listenOnUnixSocket(const string &socketPath) {
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener < 0) {
+        std::cerr << "Cannot create socket: " << std::strerror(errno) << endl;
+        return -1;
     }
 
-};
+    sockaddr_un address;
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (socketPath.length() >= sizeof(address.sun_path)) {
+        std::cerr << "Socket path is too long: " << socketPath << endl;
+        close(listener);
+        return -1;
+    }
+    std::strcpy(address.sun_path, socketPath.c_str());
+    unlink(socketPath.c_str());
+
+    if (bind(listener, reinterpret_cast<sockaddr *>(&address), sizeof(address)) < 0
+        || listen(listener, SOMAXCONN) < 0) {
+        std::cerr << "Cannot listen on " << socketPath << ": " << std::strerror(errno) << endl;
+        close(listener);
+        return -1;
+    }
+    return listener;
+}
+
+// Режим сервера: --server SOCKET_PATH [--threads N] [--cache-bytes B] [--processes P] [--artifact-dir DIR]
+//                [--result-cache FILE [--result-cache-bytes B]] [--trace TRACE]
+//                [--metrics-file FILE [--metrics-interval SECONDS]]
+// Если SOCKET_PATH равен "-", запросы читаются со стандартного входа. С --processes P соединения
+// принимают P процессов, порождённых fork; с --artifact-dir скомпилированные выражения хранятся
+// в общем для всех процессов каталоге и отображаются в память каждым процессом; с --trace все
+// запросы всех процессов записываются в один журнал для утилиты replay. Метрики общие для всех
+// процессов; с --metrics-file они раз в SECONDS секунд (по умолчанию 10) переписываются в FILE
+int runServer(const std::vector<string> &arguments) {
+    string socketPath = "-";
+    string artifactDirectory;
+    ulong threadCount = std::thread::hardware_concurrency();
+    ulong cacheBytes = 64UL << 20;
+    ulong processCount = 1;
+    string metricsPath;
+    double metricsInterval = 10;
+
+    for (ulong i = 1; i < arguments.size(); ++i) {
+        if (arguments[i] == "--threads" && i + 1 < arguments.size()) {
+            threadCount = std::strtoul(arguments[++i].c_str(), nullptr, 10);
+        } else if (arguments[i] == "--cache-bytes" && i + 1 < arguments.size()) {
+            cacheBytes = std::strtoul(arguments[++i].c_str(), nullptr, 10);
+        } else if (arguments[i] == "--processes" && i + 1 < arguments.size()) {
+            processCount = max(std::strtoul(arguments[++i].c_str(), nullptr, 10), 1UL);
+        } else if (arguments[i] == "--artifact-dir" && i + 1 < arguments.size()) {
+            artifactDirectory = arguments[++i];
+        } else if (arguments[i] == "--metrics-file" && i + 1 < arguments.size()) {
+            metricsPath = arguments[++i];
+        } else if (arguments[i] == "--metrics-interval" && i + 1 < arguments.size()) {
+            metricsInterval = std::atof(arguments[++i].c_str());
+        } else if ((arguments[i] == "--result-cache" || arguments[i] == "--result-cache-bytes"
+                    || arguments[i] == "--trace" || arguments[i] == "--tuning") && i + 1 < arguments.size()) {
+            ++i;
+        } else {
+            socketPath = arguments[i];
+        }
+    }
 
-struct Expression {
-private:
-    std::stack<Operand> operands;
-    string expression;
+    signal(SIGPIPE, SIG_IGN);
+    std::shared_ptr<const ArtifactStore> store;
+    if (!artifactDirectory.empty()) {
+        store = std::make_shared<const ArtifactStore>(artifactDirectory);
+    }
+    std::shared_ptr<TraceWriter> trace = traceArgument(arguments);
+    ServerMetrics metrics;
 
-    bool isOperator(char character) const {
-        std::set<char> allOperators({'+', '.', '*'});
-        return allOperators.count(character) == 1;
+    std::unique_ptr<MetricsFileWriter> metricsWriter;
+    if (socketPath == "-") {
+        if (!metricsPath.empty()) {
+            metricsWriter.reset(new MetricsFileWriter(metrics, metricsPath, metricsInterval));
+        }
+        QueryServer server(threadCount, cacheBytes, store, resultCacheArgument(arguments), trace, metrics);
+        server.serveConnection(STDIN_FILENO, STDOUT_FILENO);
+        return 0;
     }
 
-    bool isSymbolOfAlphabet(char character) const {
-        std::set<char> allSymbols({'a', 'b', 'c', EPSILON});
-        return allSymbols.count(character) == 1;
+    int listener = listenOnUnixSocket(socketPath);
+    if (listener < 0) {
+        return 1;
     }
 
-    void checkWord(const string &word) const {
-        if (word.empty()) {
-            throw ParseException("Word is empty");
+    // Потоки пула создаются только после fork, каждый процесс заводит свои
+    for (ulong i = 1; i < processCount; ++i) {
+        pid_t child = fork();
+        if (child < 0) {
+            std::cerr << "Cannot fork: " << std::strerror(errno) << endl;
+            break;
         }
-        for (char element : word) {
-            if (element == EPSILON || !isSymbolOfAlphabet(element)) {
-                string message = "Unknown symbol in word: " + string(1, element);
-                throw ParseException(message);
-            }
+        if (child == 0) {
+            prctl(PR_SET_PDEATHSIG, SIGTERM);
+            QueryServer server(threadCount, cacheBytes, store, resultCacheArgument(arguments), trace, metrics);
+            _exit(server.acceptConnections(listener));
         }
     }
 
-    OperatorType operatorCode(char character) const {
-        switch (character) {
-            case '+':
-                return PLUS;
-            case '.':
-                return MULTIPLY;
-            case '*':
-                return KLEENE_STAR;
-            default:
-                string message = "Unknown operator symbol: " + string(1, character);
-                throw ParseException(message);
-        }
+    // Файл метрик переписывает только родительский процесс
+    if (!metricsPath.empty()) {
+        metricsWriter.reset(new MetricsFileWriter(metrics, metricsPath, metricsInterval));
     }
+    QueryServer server(threadCount, cacheBytes, store, resultCacheArgument(arguments), trace, metrics);
+    return server.acceptConnections(listener);
+}
+
+// Компиляция в файл: --compile EXPRESSION FILE
+int runCompile(const std::vector<string> &arguments) {
+    if (arguments.size() != 3) {
+        std::cerr << "Usage: --compile EXPRESSION FILE" << endl;
+        return 1;
+    }
+    CompiledExpression(canonicalizeExpression(arguments[1])).save(arguments[2]);
+    return 0;
+}
 
-    void calculateOperator(const string &word, OperatorType currentOperator) {
-        // Calculate PLUS or MULTIPLY or KLEENE STAR
-        if (currentOperator == KLEENE_STAR) {
-            calculateKleeneStar(word);
-            return;
-        }
-
-        // Calculate PLUS or MULTIPLY
-        if (operands.size() < 2) {
-            throw ParseException("Missing operands");
+// Потоковый режим: --stream EXPRESSION [--window W] [--fd N | FILE]
+// Слово читается блоками, после каждого блока печатается ответ, если он изменился
+int runStream(const std::vector<string> &arguments) {
+    string expression;
+    ulong window = 0;
+    int fd = STDIN_FILENO;
+    bool ownsFd = false;
+
+    for (ulong i = 1; i < arguments.size(); ++i) {
+        if (arguments[i] == "--window" && i + 1 < arguments.size()) {
+            window = std::strtoul(arguments[++i].c_str(), nullptr, 10);
+        } else if (arguments[i] == "--fd" && i + 1 < arguments.size()) {
+            fd = std::atoi(arguments[++i].c_str());
+        } else if (arguments[i] == "--tuning" && i + 1 < arguments.size()) {
+            ++i;
+        } else if (expression.empty()) {
+            expression = arguments[i];
+        } else {
+            fd = open(arguments[i].c_str(), O_RDONLY);
+            if (fd < 0) {
+                std::cerr << "Cannot open " << arguments[i] << ": " << std::strerror(errno) << endl;
+                return 1;
+            }
+            ownsFd = true;
         }
+    }
 
-        Operand right = operands.top();
-        operands.pop();
-        Operand left = operands.top();
-        operands.pop();
+    PositionAutomaton automaton(expression);
+    FactorTracker tracker(automaton.view(), window);
 
-        operands.push(currentOperator == PLUS ? left + right : left * right);
-    }
+    std::vector<char> buffer(STREAM_BLOCK_SIZE);
+    ulong reported = ULONG_MAX;
 
-    void calculateKleeneStar(const string &word) {
-        if (operands.size() < 1) {
-            throw ParseException("Missing operands");
+    while (true) {
+        ssize_t bytesRead = read(fd, buffer.data(), buffer.size());
+        if (bytesRead < 0 && errno == EINTR) {
+            continue;
+        }
+        if (bytesRead < 0) {
+            std::cerr << "Read error: " << std::strerror(errno) << endl;
+            return 1;
+        }
+        if (bytesRead == 0) {
+            break;
         }
 
-        // e* = e^0 + e^1 + e^2 ... e^n + e^(n+1) ...
-
-        // n == 0:
-        Operand currentPow(EPSILON, word); // Операнд, задающий язык из пустого слова
-        Operand startOperand = operands.top(); // startOperand := e
-        operands.pop();
-        Operand currentOperand = currentPow; // e^0 -- язык из пустого слова
+        tracker.advance(buffer.data(), static_cast<ulong>(bytesRead));
 
-        // n > 0 && n < 2 * length + 2:
-        for (ulong i = 0; i < 2 * word.length() + 2; ++i) {
-            Operand nextPow = currentPow * startOperand; // nextPow := e^n * e
-            Operand nextOperand = currentOperand + nextPow; // nextOperand := e^n + e^(n+1)
-            currentPow = nextPow;
-            currentOperand = nextOperand;
+        if (tracker.longestFactor() != reported) {
+            reported = tracker.longestFactor();
+            cout << reported << endl;
         }
+    }
 
-        operands.push(currentOperand);
+    if (ownsFd) {
+        close(fd);
+    }
+    if (tracker.longestFactor() != reported) {
+        cout << tracker.longestFactor() << endl;
     }
 
-public:
+    return 0;
+}
 
-    void readExpression() {
-        cin >> expression;
+int main(int argc, char *argv[]) {
+    std::vector<string> arguments(argv + 1, argv + argc);
 
-        if (expression.empty()) {
-            throw ParseException("Expression is empty");
-        }
+    std::ios_base::sync_with_stdio(false);
+
+    try {
+        installTuningArgument(arguments);
+    } catch (ParseException e) {
+        std::cerr << e.what() << endl;
+        return 1;
     }
 
-    Operand calculateValueOfExpression(const string &word) {
-        checkWord(word);
+    if (!arguments.empty() && arguments[0] == "--server") {
+        return runServer(arguments);
+    }
 
-        for (ulong i = 0; i < expression.length(); ++i) {
-            if (isOperator(expression[i])) {
-                OperatorType currentOperator = operatorCode(expression[i]);
-                calculateOperator(word, currentOperator);
-            } else if (isSymbolOfAlphabet(expression[i])) {
-                operands.push(Operand(expression[i], word));
-            } else {
-                string message = "Unknown symbol in expression: " + string(1, expression[i]);
-                throw ParseException(message);
+    if (!arguments.empty() && (arguments[0] == "--stream" || arguments[0] == "--batch" || arguments[0] == "--pairs"
+                               || arguments[0] == "--compile")) {
+        try {
+            if (arguments[0] == "--stream") {
+                return runStream(arguments);
             }
+            if (arguments[0] == "--compile") {
+                return runCompile(arguments);
+            }
+            return arguments[0] == "--batch" ? runBatch(arguments) : runPairs(arguments);
+        } catch (ParseException e) {
+            std::cerr << e.what() << endl;
+            return 1;
         }
-
-        if (operands.size() > 1) {
-            throw ParseException("Too much operands");
-        }
-        if (operands.size() < 1) {
-            throw ParseException("Missing operands");
-        }
-        return operands.top();
     }
 
-};
-
-struct Solver {
-private:
     Expression expression;
-    string word;
-
-public:
-    Solver(const Expression &expression, const string &word) :
-            expression(expression), word(word) {}
 
-    Solver() {}
+    // С --operator-trace FILE интервалы применений операторов записываются в FILE
+    // в формате Chrome trace-event JSON (только в сборке с FORMAL_LANGUAGE_OPERATOR_TRACE)
+    string operatorTracePath = optionArgument(arguments, "--operator-trace");
+#ifndef FORMAL_LANGUAGE_OPERATOR_TRACE
+    if (!operatorTracePath.empty()) {
+        std::cerr << "Operator tracing is disabled in this build; configure with -DFORMAL_LANGUAGE_OPERATOR_TRACE=ON"
+                  << endl;
+        return 1;
+    }
+#endif
 
-    ulong solve() {
-        ulong answer = 0;
+    // С --profile table|json по фазам вычисления печатаются аппаратные счётчики (в стандартный поток ошибок)
+    string profileFormat = optionArgument(arguments, "--profile");
+    if (!profileFormat.empty() && profileFormat != "table" && profileFormat != "json") {
+        std::cerr << "Unknown profile format: " << profileFormat << endl;
+        return 1;
+    }
+    std::unique_ptr<PhaseProfiler> profiler;
+    if (!profileFormat.empty()) {
+        profiler.reset(new PhaseProfiler());
+    }
 
-        for (ulong startPosition = 0; startPosition < word.length(); ++startPosition) {
-            for (ulong length = 1; length <= word.length() - startPosition; ++length) {
-                string toCheck = word.substr(startPosition, length);
+    // С --memory-limit BYTES вычисление прерывается, если таблицам операндов нужно больше BYTES байт;
+    // с --memory-report в стандартный поток ошибок печатается память таблиц
+    string memoryLimit = optionArgument(arguments, "--memory-limit");
+    bool memoryReport = flagArgument(arguments, "--memory-report");
+
+    // С --deadline-ms MS и/или --work-budget CELLS вычисление останавливается по сроку или после
+    // CELLS ячеек таблиц; тогда печатается доказанная нижняя граница ответа с пометкой partial
+    string deadline = optionArgument(arguments, "--deadline-ms");
+    string workBudget = optionArgument(arguments, "--work-budget");
+    EvaluationBudget budget = EvaluationBudget::work(std::strtoul(workBudget.c_str(), nullptr, 10));
+    if (!deadline.empty()) {
+        budget = EvaluationBudget::timeout(std::chrono::milliseconds(std::strtoul(deadline.c_str(), nullptr, 10)),
+                                           budget.workLimit);
+    }
 
-                Expression bufferExpression = expression;
-                Operand result = bufferExpression.calculateValueOfExpression(toCheck);
+    // С --engine auto|operand|automaton|finite движок выбирается по оценке стоимости (по умолчанию) или
+    // задаётся явно; с --explain оценки и выбранный план печатаются в стандартный поток ошибок.
+    // Опции выше относятся к исходному алгоритму и требуют движка operand
+    string engineName = optionArgument(arguments, "--engine");
+    if (!engineName.empty() && engineName != "auto" && engineName != planEngineName(ENGINE_OPERAND)
+        && engineName != planEngineName(ENGINE_AUTOMATON) && engineName != planEngineName(ENGINE_FINITE)) {
+        std::cerr << "Unknown engine: " << engineName << endl;
+        return 1;
+    }
+    bool explain = flagArgument(arguments, "--explain");
+    string operandOption;
+    if (!operatorTracePath.empty()) {
+        operandOption = "--operator-trace";
+    } else if (!profileFormat.empty()) {
+        operandOption = "--profile";
+    } else if (!memoryLimit.empty()) {
+        operandOption = "--memory-limit";
+    } else if (memoryReport) {
+        operandOption = "--memory-report";
+    } else if (!deadline.empty()) {
+        operandOption = "--deadline-ms";
+    } else if (!workBudget.empty()) {
+        operandOption = "--work-budget";
+    }
+    if (!engineName.empty() && engineName != "auto" && engineName != planEngineName(ENGINE_OPERAND)
+        && !operandOption.empty()) {
+        std::cerr << "Option " << operandOption << " requires the operand engine" << endl;
+        return 1;
+    }
 
-                if (result.isWordEqualToSomeSubstringInLanguage()) {
-                    answer = max(answer, length);
-                }
-            }
-        }
+    // С --weights count|min-cost|max-cost после ответа печатается число выводов самых длинных
+    // подходящих подслов или их стоимость (--leaf-costs задаёт стоимости листьев)
+    string weights = optionArgument(arguments, "--weights");
+    string leafCosts = optionArgument(arguments, "--leaf-costs");
+    if (!weights.empty() && weights != CountingSemiring::name() && weights != MinCostSemiring::name()
+        && weights != MaxCostSemiring::name()) {
+        std::cerr << "Unknown weights: " << weights << endl;
+        return 1;
+    }
+    if (!leafCosts.empty() && weights != MinCostSemiring::name() && weights != MaxCostSemiring::name()) {
+        std::cerr << "Option --leaf-costs requires --weights min-cost or max-cost" << endl;
+        return 1;
+    }
 
-        return answer;
+    // С --approximate K ищется самое длинное подслово, которое отличается от подслова какого-либо
+    // слова языка не больше чем на K правок; выбор движка и кэш ответов к этому запросу не относятся
+    string approximate = optionArgument(arguments, "--approximate");
+    char *editsEnd = nullptr;
+    ulong edits = std::strtoul(approximate.c_str(), &editsEnd, 10);
+    if (!approximate.empty() && (*editsEnd != '\0' || approximate[0] == '-')) {
+        std::cerr << "Invalid edit count: " << approximate << endl;
+        return 1;
+    }
+    if (!approximate.empty() && (!engineName.empty() || !operandOption.empty() || !weights.empty())) {
+        std::cerr << "Option --approximate cannot be combined with "
+                  << (!engineName.empty() ? "--engine" : !operandOption.empty() ? operandOption : "--weights") << endl;
+        return 1;
     }
-};
 
-int main() {
-    freopen("input.txt", "rt", stdin);
+    try {
+        MappedInput input("input.txt");
+        expression.readExpression(input);
+        string_view word = input.nextToken();
+
+        if (!approximate.empty()) {
+            PositionAutomaton automaton(expression.getExpression());
+            cout << ApproximateMatcher(automaton.view(), edits).longestFactor(word) << endl;
+            return 0;
+        }
 
-    Expression expression;
-    string word;
+        // С --result-cache FILE ответ сначала ищется в постоянном кэше,
+        // с --trace FILE запрос записывается в журнал
+        std::unique_ptr<ResultCache> resultCache = resultCacheArgument(arguments);
+        std::unique_ptr<TraceWriter> trace = traceArgument(arguments);
+        auto start = std::chrono::steady_clock::now();
+        ResultCache::Key key;
+        ulong answer;
+        if (resultCache) {
+            validateWord(word);
+            key = ResultCache::makeKey(canonicalizeExpression(expression.getExpression()), word);
+            if (resultCache->lookup(key, answer)) {
+                if (trace) {
+                    trace->record(TRACE_RESULT_CACHE, std::chrono::steady_clock::now() - start, false, answer,
+                                  expression.getExpression(), word);
+                }
+                string weightColumn = weightsColumn(weights, leafCosts, expression.getExpression(), word, answer);
+                cout << answer << weightColumn << endl;
+                return 0;
+            }
+        }
 
-    try {
-        expression.readExpression();
-        cin >> word;
+        QueryPlan plan(expression.getExpression(), word.length());
+        if (engineName == planEngineName(ENGINE_OPERAND)) {
+            plan.force(ENGINE_OPERAND, "--engine operand");
+        } else if (engineName == planEngineName(ENGINE_AUTOMATON)) {
+            plan.force(ENGINE_AUTOMATON, "--engine automaton");
+        } else if (engineName == planEngineName(ENGINE_FINITE)) {
+            plan.force(ENGINE_FINITE, "--engine finite");
+        } else if (!operandOption.empty()) {
+            plan.force(ENGINE_OPERAND, "required by " + operandOption);
+        }
+        if (explain) {
+            plan.print(stderr);
+        }
 
-        Solver solver(expression, word);
+        // Запрос вычисляет библиотека (formal_language.h) движком этого плана. Трассировка
+        // операторов, профилирование и отчёт о памяти наблюдают сам Solver на записи из входа
+        PartialAnswer result{0, false};
+        if (!operatorTracePath.empty() || profiler || memoryReport) {
+            Solver solver(expression, word);
+            result = solver.solveWithin(budget, std::strtoul(memoryLimit.c_str(), nullptr, 10));
+            if (memoryReport) {
+                std::cerr << "peak_live_bytes " << solver.getMemoryStatistics().peakLiveBytes
+                          << " allocated_bytes " << solver.getMemoryStatistics().allocatedBytes << endl;
+            }
+        } else {
+            // Как в исходном алгоритме, ошибка в слове сообщается раньше ошибки в выражении
+            if (!word.empty()) {
+                validateWord(word);
+            }
+            formal_language::EvaluationOptions options;
+            options.engine = libraryEngine(plan.getEngine());
+            options.deadlineMilliseconds = std::strtoul(deadline.c_str(), nullptr, 10);
+            options.workBudget = budget.workLimit;
+            options.memoryLimitBytes = std::strtoul(memoryLimit.c_str(), nullptr, 10);
+            formal_language::Evaluation evaluation =
+                    formal_language::CompiledRegex::compile(expression.getExpression()).evaluate(word, options);
+            result = PartialAnswer{evaluation.length, evaluation.partial};
+        }
+        answer = result.length;
+        if (resultCache && !result.partial) {
+            resultCache->store(key, answer);
+        }
+#ifdef FORMAL_LANGUAGE_OPERATOR_TRACE
+        if (!operatorTracePath.empty()) {
+            std::ofstream operatorTrace(operatorTracePath);
+            OperatorTrace::instance().writeChromeJson(operatorTrace);
+        }
+#endif
+        if (profiler) {
+            if (profileFormat == "json") {
+                profiler->printJson(stderr);
+            } else {
+                profiler->printTable(stderr);
+            }
+        }
+        // Журнал различает исходный алгоритм и автоматы: ответ индекса конечного языка
+        // записывается как ответ автомата и воспроизводится автоматом позиций
+        if (trace) {
+            trace->record(plan.getEngine() == ENGINE_OPERAND ? TRACE_OPERAND : TRACE_AUTOMATON,
+                          std::chrono::steady_clock::now() - start, false, answer, expression.getExpression(), word);
+        }
 
-        cout << solver.solve() << endl;
+        if (result.partial) {
+            cout << answer << " partial" << endl;
+        } else {
+            string weightColumn = weightsColumn(weights, leafCosts, expression.getExpression(), word, answer);
+            cout << answer << weightColumn << endl;
+        }
     } catch (ParseException e) {
         std::cerr << e.what() << endl;
         return 1;
+    } catch (MemoryLimitException e) {
+        std::cerr << e.what() << endl;
+        return 3;
+    } catch (const formal_language::MemoryLimitError &e) {
+        std::cerr << e.what() << endl;
+        return 3;
+    } catch (const formal_language::Error &e) {
+        std::cerr << e.what() << endl;
+        return 1;
     }
 
     return 0;
-}
\ No newline at end of file
+}
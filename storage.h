@@ -0,0 +1,471 @@
+#ifndef FORMAL_LANGUAGE_STORAGE_H
+#define FORMAL_LANGUAGE_STORAGE_H
+
+// Кэши и хранилища скомпилированных выражений и ответов
+
+#include <atomic>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <cstdio>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "automaton.h"
+
+// Каталог скомпилированных выражений, общий для всех процессов машины (по умолчанию
+// в /dev/shm). Каждое выражение хранится в своём файле, и все процессы отображают его
+// в память только для чтения, поэтому таблицы автомата занимают память один раз на машину,
+// сколько бы процессов ими ни пользовалось
+struct ArtifactStore {
+private:
+    string directory;
+
+    string pathFor(const string &canonicalExpression) const {
+        char name[32];
+        std::snprintf(name, sizeof(name), "%016lx.fla", fnv1aHash(canonicalExpression));
+        return directory + "/" + name;
+    }
+
+public:
+    explicit ArtifactStore(const string &directory) : directory(directory) {
+        if (mkdir(directory.c_str(), 0755) != 0 && errno != EEXIST) {
+            throw ParseException("Cannot create " + directory + ": " + std::strerror(errno));
+        }
+    }
+
+    // Выражение в канонической записи. Если его ещё нет в каталоге, оно компилируется и
+    // записывается; при совпадении хешей разных выражений используется частная копия
+    CompiledExpression get(const string &canonicalExpression) const {
+        string path = pathFor(canonicalExpression);
+        bool collision = false;
+
+        try {
+            CompiledExpression stored = CompiledExpression::load(path);
+            if (stored.getExpression() == canonicalExpression) {
+                return stored;
+            }
+            collision = true;
+        } catch (ParseException e) {
+            // файла ещё нет или он записан другой версией программы
+        }
+
+        CompiledExpression compiled(canonicalExpression);
+        if (collision) {
+            return compiled;
+        }
+        try {
+            compiled.save(path);
+            return CompiledExpression::load(path);
+        } catch (ParseException e) {
+            return compiled;
+        }
+    }
+};
+
+// Хеш-функция SHA-256
+struct Sha256 {
+private:
+    unsigned state[8];
+    unsigned char block[64];
+    ulong blockLength;
+    ulong totalLength;
+
+    static unsigned rotateRight(unsigned value, int shift) {
+        return (value >> shift) | (value << (32 - shift));
+    }
+
+    void compress() {
+        static const unsigned ROUND_CONSTANTS[64] = {
+                0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+                0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+                0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+                0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+                0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+                0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+                0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+                0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2};
+
+        unsigned schedule[64];
+        for (int i = 0; i < 16; ++i) {
+            schedule[i] = (unsigned(block[4 * i]) << 24) | (unsigned(block[4 * i + 1]) << 16)
+                          | (unsigned(block[4 * i + 2]) << 8) | unsigned(block[4 * i + 3]);
+        }
+        for (int i = 16; i < 64; ++i) {
+            unsigned sigma0 = rotateRight(schedule[i - 15], 7) ^ rotateRight(schedule[i - 15], 18)
+                              ^ (schedule[i - 15] >> 3);
+            unsigned sigma1 = rotateRight(schedule[i - 2], 17) ^ rotateRight(schedule[i - 2], 19)
+                              ^ (schedule[i - 2] >> 10);
+            schedule[i] = schedule[i - 16] + sigma0 + schedule[i - 7] + sigma1;
+        }
+
+        unsigned a = state[0], b = state[1], c = state[2], d = state[3];
+        unsigned e = state[4], f = state[5], g = state[6], h = state[7];
+        for (int i = 0; i < 64; ++i) {
+            unsigned sum1 = rotateRight(e, 6) ^ rotateRight(e, 11) ^ rotateRight(e, 25);
+            unsigned choice = (e & f) ^ (~e & g);
+            unsigned first = h + sum1 + choice + ROUND_CONSTANTS[i] + schedule[i];
+            unsigned sum0 = rotateRight(a, 2) ^ rotateRight(a, 13) ^ rotateRight(a, 22);
+            unsigned majority = (a & b) ^ (a & c) ^ (b & c);
+            unsigned second = sum0 + majority;
+            h = g;
+            g = f;
+            f = e;
+            e = d + first;
+            d = c;
+            c = b;
+            b = a;
+            a = first + second;
+        }
+
+        state[0] += a;
+        state[1] += b;
+        state[2] += c;
+        state[3] += d;
+        state[4] += e;
+        state[5] += f;
+        state[6] += g;
+        state[7] += h;
+    }
+
+public:
+    Sha256() : state{0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19},
+               blockLength(0), totalLength(0) {}
+
+    void update(string_view data) {
+        for (char character : data) {
+            block[blockLength++] = static_cast<unsigned char>(character);
+            if (blockLength == 64) {
+                compress();
+                blockLength = 0;
+            }
+        }
+        totalLength += data.length();
+    }
+
+    // Первые 16 байт хеша как два 64-битных числа
+    std::pair<ulong, ulong> finish() {
+        ulong bitLength = totalLength * 8;
+        update(string_view("\x80", 1));
+        while (blockLength != 56) {
+            update(string_view("\0", 1));
+        }
+        for (int shift = 56; shift >= 0; shift -= 8) {
+            block[blockLength++] = static_cast<unsigned char>(bitLength >> shift);
+        }
+        compress();
+
+        return std::make_pair((ulong(state[0]) << 32) | state[1], (ulong(state[2]) << 32) | state[3]);
+    }
+};
+
+// Постоянный кэш ответов на пары (выражение, слово), общий для процессов и переживающий
+// перезапуск. Это отображённая в память наборно-ассоциативная хеш-таблица фиксированного
+// размера: ключ -- 128 бит SHA-256 от канонической записи выражения и слова, при заполнении
+// набора вытесняется запись, которой дольше всех не пользовались. Записи читаются и пишутся
+// без блокировок; запись, прочитанная во время перезаписи, не проходит проверку и считается
+// промахом
+struct ResultCache {
+public:
+    typedef std::pair<ulong, ulong> Key;
+
+private:
+    struct Header {
+        char magic[8];
+        ulong version;
+        ulong setCount;
+        ulong clock; // счётчик обращений, задаёт возраст записей
+    };
+
+    struct Slot {
+        ulong key[2];
+        ulong answer;
+        ulong check;
+        ulong stamp; // 0 -- пустая ячейка
+    };
+
+    static const ulong WAYS = 8;
+
+    Header *header;
+    Slot *slots;
+    ulong setCount;
+    ulong mappedSize;
+    std::atomic<ulong> hits;
+    std::atomic<ulong> misses;
+
+    static ulong checkValue(ulong key0, ulong key1, ulong answer) {
+        return key0 ^ ((key1 << 17) | (key1 >> 47)) ^ (answer * 0x9e3779b97f4a7c15UL) ^ 0x5bd1e9955bd1e995UL;
+    }
+
+    static ulong loadField(const ulong &field) {
+        return __atomic_load_n(&field, __ATOMIC_ACQUIRE);
+    }
+
+    static void storeField(ulong &field, ulong value) {
+        __atomic_store_n(&field, value, __ATOMIC_RELEASE);
+    }
+
+    ulong nextStamp() {
+        return __atomic_add_fetch(&header->clock, 1, __ATOMIC_RELAXED);
+    }
+
+    // Число наборов читается из заголовка один раз при отображении: заголовок общий, и по нему
+    // нельзя индексировать собственное отображение
+    Slot *findSet(const Key &key) const {
+        return slots + (key.first % setCount) * WAYS;
+    }
+
+    static ulong fileSize(ulong sets) {
+        return sizeof(Header) + sets * WAYS * sizeof(Slot);
+    }
+
+    // Заголовок и размер файла согласованы; число наборов может отличаться от запрошенного
+    static bool isValid(int fd, Header &existing) {
+        struct stat status;
+        std::memset(&existing, 0, sizeof(existing));
+        return fstat(fd, &status) == 0
+               && pread(fd, &existing, sizeof(existing), 0) == static_cast<ssize_t>(sizeof(existing))
+               && std::memcmp(existing.magic, "FLRESULT", 8) == 0 && existing.version == 1
+               && existing.setCount != 0
+               && existing.setCount <= (static_cast<ulong>(-1) - sizeof(Header)) / (WAYS * sizeof(Slot))
+               && static_cast<ulong>(status.st_size) == fileSize(existing.setCount);
+    }
+
+    // Пустая таблица из sets наборов в файле fd
+    static bool initialize(int fd, ulong sets) {
+        Header fresh;
+        std::memset(&fresh, 0, sizeof(fresh));
+        std::memcpy(fresh.magic, "FLRESULT", 8);
+        fresh.version = 1;
+        fresh.setCount = sets;
+        return ftruncate(fd, static_cast<off_t>(fileSize(sets))) == 0
+               && pwrite(fd, &fresh, sizeof(fresh), 0) == static_cast<ssize_t>(sizeof(fresh));
+    }
+
+    // Открывает path и берёт на нём блокировку. Файл могли заменить (rename) между open и flock,
+    // тогда блокировка взята на старом файле и открытие повторяется
+    static int openLocked(const string &path) {
+        while (true) {
+            int fd = open(path.c_str(), O_RDWR | O_CREAT, 0644);
+            if (fd < 0) {
+                throw ParseException("Cannot open " + path + ": " + std::strerror(errno));
+            }
+            flock(fd, LOCK_EX);
+            struct stat opened;
+            struct stat current;
+            if (fstat(fd, &opened) == 0 && stat(path.c_str(), &current) == 0 && opened.st_dev == current.st_dev
+                && opened.st_ino == current.st_ino) {
+                return fd;
+            }
+            close(fd);
+        }
+    }
+
+    // Файл с чужими данными мог быть отображён другим процессом, поэтому он не обрезается:
+    // новая таблица пишется во временный файл рядом и переименовывается на его место.
+    // Отображения старого файла остаются верными до закрытия
+    static int replaceFile(const string &path, ulong sets) {
+        string temporaryPath;
+        int fd = createTemporaryFile(path, temporaryPath);
+        if (fd < 0) {
+            throw ParseException("Cannot create " + temporaryPath + ": " + std::strerror(errno));
+        }
+        if (!initialize(fd, sets) || rename(temporaryPath.c_str(), path.c_str()) != 0) {
+            string message = std::strerror(errno);
+            close(fd);
+            unlink(temporaryPath.c_str());
+            throw ParseException("Cannot initialize " + path + ": " + message);
+        }
+        return fd;
+    }
+
+public:
+    // Если в path уже есть кэш, используется его размер, а byteBudget задаёт размер только нового
+    // кэша: процессы с разными --result-cache-bytes работают с одной таблицей
+    ResultCache(const string &path, ulong byteBudget) : hits(0), misses(0) {
+        setCount = max(byteBudget / (WAYS * sizeof(Slot)), 1UL);
+
+        int fd = openLocked(path);
+        Header existing;
+        struct stat status;
+        if (isValid(fd, existing)) {
+            setCount = existing.setCount;
+        } else if (fstat(fd, &status) == 0 && status.st_size == 0) {
+            // Только что созданный файл: пока он пуст, отобразить его не мог никто
+            if (!initialize(fd, setCount)) {
+                string message = std::strerror(errno);
+                close(fd);
+                throw ParseException("Cannot initialize " + path + ": " + message);
+            }
+        } else {
+            int fresh;
+            try {
+                fresh = replaceFile(path, setCount);
+            } catch (...) {
+                close(fd);
+                throw;
+            }
+            close(fd);
+            fd = fresh;
+        }
+        mappedSize = fileSize(setCount);
+
+        void *address = mmap(nullptr, mappedSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        flock(fd, LOCK_UN);
+        close(fd);
+        if (address == MAP_FAILED) {
+            throw ParseException("Cannot map " + path + ": " + std::strerror(errno));
+        }
+        header = static_cast<Header *>(address);
+        slots = reinterpret_cast<Slot *>(static_cast<char *>(address) + sizeof(Header));
+    }
+
+    ResultCache(const ResultCache &) = delete;
+    ResultCache &operator=(const ResultCache &) = delete;
+
+    ~ResultCache() {
+        munmap(header, mappedSize);
+    }
+
+    static Key makeKey(string_view canonicalExpression, string_view word) {
+        Sha256 hash;
+        hash.update(canonicalExpression);
+        hash.update(string_view("\0", 1));
+        hash.update(word);
+        return hash.finish();
+    }
+
+    bool lookup(const Key &key, ulong &answer) {
+        Slot *set = findSet(key);
+        for (ulong way = 0; way < WAYS; ++way) {
+            Slot &slot = set[way];
+            ulong stamp = loadField(slot.stamp);
+            if (stamp == 0 || loadField(slot.key[0]) != key.first || loadField(slot.key[1]) != key.second) {
+                continue;
+            }
+            ulong storedAnswer = loadField(slot.answer);
+            if (loadField(slot.check) != checkValue(key.first, key.second, storedAnswer)
+                || loadField(slot.stamp) != stamp) {
+                continue;
+            }
+            storeField(slot.stamp, nextStamp());
+            answer = storedAnswer;
+            ++hits;
+            return true;
+        }
+        ++misses;
+        return false;
+    }
+
+    void store(const Key &key, ulong answer) {
+        Slot *set = findSet(key);
+        Slot *victim = set;
+        for (ulong way = 0; way < WAYS; ++way) {
+            Slot &slot = set[way];
+            if (loadField(slot.key[0]) == key.first && loadField(slot.key[1]) == key.second) {
+                victim = &slot;
+                break;
+            }
+            if (loadField(slot.stamp) < loadField(victim->stamp)) {
+                victim = &slot;
+            }
+        }
+
+        storeField(victim->stamp, 0);
+        storeField(victim->key[0], key.first);
+        storeField(victim->key[1], key.second);
+        storeField(victim->answer, answer);
+        storeField(victim->check, checkValue(key.first, key.second, answer));
+        storeField(victim->stamp, nextStamp());
+    }
+
+    ulong getHits() const {
+        return hits;
+    }
+
+    ulong getMisses() const {
+        return misses;
+    }
+};
+
+// LRU-кэш скомпилированных выражений с ограничением на суммарный объём памяти.
+// Ключ -- каноническая запись выражения. Потокобезопасен
+struct CompileCache {
+public:
+    struct Statistics {
+        ulong hits;
+        ulong misses;
+        ulong evictions;
+        ulong entries;
+        ulong bytes;
+    };
+
+private:
+    typedef std::pair<string, std::shared_ptr<const CompiledExpression> > Entry;
+
+    ulong byteBudget;
+    std::shared_ptr<const ArtifactStore> store;
+    std::list<Entry> entries; // от недавно использованных к давно использованным
+    std::unordered_map<string, std::list<Entry>::iterator> index;
+    Statistics statistics;
+    mutable std::mutex mutex;
+
+    void evictOverBudget() {
+        while (statistics.bytes > byteBudget && !entries.empty()) {
+            statistics.bytes -= entries.back().second->byteSize();
+            index.erase(entries.back().first);
+            entries.pop_back();
+            ++statistics.evictions;
+        }
+    }
+
+public:
+    // Если store задан, промахи обслуживаются общим каталогом скомпилированных выражений
+    CompileCache(ulong byteBudget, std::shared_ptr<const ArtifactStore> store) :
+            byteBudget(byteBudget), store(store), statistics{0, 0, 0, 0, 0} {}
+
+    // Если hit задан, в него записывается, нашлось ли выражение в кэше
+    std::shared_ptr<const CompiledExpression> get(string_view expression, bool *hit = nullptr) {
+        string key = canonicalizeExpression(expression);
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto found = index.find(key);
+            if (hit != nullptr) {
+                *hit = found != index.end();
+            }
+            if (found != index.end()) {
+                entries.splice(entries.begin(), entries, found->second);
+                ++statistics.hits;
+                return found->second->second;
+            }
+            ++statistics.misses;
+        }
+
+        // Компиляция идёт без блокировки; если два потока скомпилировали одно выражение,
+        // в кэше остаётся одна копия
+        std::shared_ptr<const CompiledExpression> compiled =
+                store ? std::make_shared<const CompiledExpression>(store->get(key))
+                      : std::make_shared<const CompiledExpression>(key);
+
+        std::lock_guard<std::mutex> lock(mutex);
+        if (index.count(key) == 0 && compiled->byteSize() <= byteBudget) {
+            entries.emplace_front(key, compiled);
+            index[key] = entries.begin();
+            statistics.bytes += compiled->byteSize();
+            evictOverBudget();
+        }
+        return compiled;
+    }
+
+    Statistics getStatistics() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        Statistics result = statistics;
+        result.entries = entries.size();
+        return result;
+    }
+};
+
+#endif // FORMAL_LANGUAGE_STORAGE_H
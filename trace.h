@@ -0,0 +1,173 @@
+#ifndef FORMAL_LANGUAGE_TRACE_H
+#define FORMAL_LANGUAGE_TRACE_H
+
+// Запись запросов в двоичный журнал для последующего воспроизведения.
+// Файл начинается с заголовка TRACE_MAGIC, затем идут записи подряд. Числа записаны
+// кодом LEB128 (по 7 бит в байте, старший бит -- признак продолжения):
+// движок (1 байт), задержка в наносекундах, ответ + 1 (0 -- ошибка разбора),
+// длина выражения, байты выражения, длина слова, байты слова
+
+#include <chrono>
+#include <mutex>
+#include <cstring>
+#include <fcntl.h>
+
+#include "common.h"
+#include "input.h"
+
+const char TRACE_MAGIC[8] = {'F', 'L', 'T', 'R', 'A', 'C', 'E', '1'};
+
+// Чем был получен ответ на запрос
+enum TraceEngine {
+    TRACE_AUTOMATON = 0,    // автомат позиций (CompiledExpression)
+    TRACE_OPERAND = 1,      // динамика по подсловам (Solver)
+    TRACE_RESULT_CACHE = 2  // постоянный кэш ответов
+};
+
+inline const char *traceEngineName(TraceEngine engine) {
+    switch (engine) {
+        case TRACE_AUTOMATON:
+            return "automaton";
+        case TRACE_OPERAND:
+            return "operand";
+        default:
+            return "result_cache";
+    }
+}
+
+struct TraceRecord {
+    TraceEngine engine;
+    ulong latencyNanoseconds;
+    bool failed;
+    ulong answer;
+    string_view expression;
+    string_view word;
+};
+
+// Журнал запросов, открытый на дозапись. Записи копятся в буфере и сбрасываются в файл
+// целиком одним вызовом write, поэтому процессы сервера, унаследовавшие дескриптор после
+// fork, могут писать в один файл. Потокобезопасен
+struct TraceWriter {
+private:
+    int fd;
+    string buffer;
+    std::mutex mutex;
+
+    static void appendNumber(string &output, ulong value) {
+        while (value >= 0x80) {
+            output += static_cast<char>((value & 0x7F) | 0x80);
+            value >>= 7;
+        }
+        output += static_cast<char>(value);
+    }
+
+    void flushLocked() {
+        if (!buffer.empty()) {
+            writeAll(fd, buffer);
+            buffer.clear();
+        }
+    }
+
+public:
+    // Файл создаётся заново
+    explicit TraceWriter(const string &path) {
+        fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0644);
+        if (fd < 0) {
+            throw ParseException("Cannot create " + path + ": " + std::strerror(errno));
+        }
+        if (!writeAll(fd, string(TRACE_MAGIC, sizeof(TRACE_MAGIC)))) {
+            close(fd);
+            throw ParseException("Cannot write " + path + ": " + std::strerror(errno));
+        }
+    }
+
+    TraceWriter(const TraceWriter &) = delete;
+    TraceWriter &operator=(const TraceWriter &) = delete;
+
+    ~TraceWriter() {
+        flushLocked();
+        close(fd);
+    }
+
+    void record(TraceEngine engine, std::chrono::steady_clock::duration latency, bool failed, ulong answer,
+                string_view expression, string_view word) {
+        std::lock_guard<std::mutex> lock(mutex);
+        buffer += static_cast<char>(engine);
+        appendNumber(buffer, static_cast<ulong>(
+                std::chrono::duration_cast<std::chrono::nanoseconds>(latency).count()));
+        appendNumber(buffer, failed ? 0 : answer + 1);
+        appendNumber(buffer, expression.length());
+        buffer.append(expression.data(), expression.length());
+        appendNumber(buffer, word.length());
+        buffer.append(word.data(), word.length());
+        if (buffer.length() >= STREAM_BLOCK_SIZE) {
+            flushLocked();
+        }
+    }
+
+    void flush() {
+        std::lock_guard<std::mutex> lock(mutex);
+        flushLocked();
+    }
+};
+
+// Последовательное чтение журнала, отображённого в память; выражения и слова записей
+// указывают на отображённые байты
+struct TraceReader {
+private:
+    MappedRegion region;
+    ulong position;
+
+    ulong readNumber() {
+        ulong value = 0;
+        for (ulong shift = 0;; shift += 7) {
+            if (position >= region.getSize() || shift >= 64) {
+                throw ParseException("Truncated trace record");
+            }
+            unsigned char byte = static_cast<unsigned char>(region.getData()[position++]);
+            value |= static_cast<ulong>(byte & 0x7F) << shift;
+            if ((byte & 0x80) == 0) {
+                return value;
+            }
+        }
+    }
+
+    string_view readBytes() {
+        ulong length = readNumber();
+        if (length > region.getSize() - position) {
+            throw ParseException("Truncated trace record");
+        }
+        string_view bytes(region.getData() + position, length);
+        position += length;
+        return bytes;
+    }
+
+public:
+    explicit TraceReader(const string &path) : region(path), position(sizeof(TRACE_MAGIC)) {
+        if (region.getSize() < sizeof(TRACE_MAGIC)
+            || std::memcmp(region.getData(), TRACE_MAGIC, sizeof(TRACE_MAGIC)) != 0) {
+            throw ParseException("Invalid trace file: " + path);
+        }
+    }
+
+    // Следующая запись; false, если журнал закончился
+    bool next(TraceRecord &record) {
+        if (position >= region.getSize()) {
+            return false;
+        }
+        unsigned char engine = static_cast<unsigned char>(region.getData()[position++]);
+        if (engine > TRACE_RESULT_CACHE) {
+            throw ParseException("Unknown engine in trace record: " + std::to_string(engine));
+        }
+        record.engine = static_cast<TraceEngine>(engine);
+        record.latencyNanoseconds = readNumber();
+        ulong answer = readNumber();
+        record.failed = answer == 0;
+        record.answer = record.failed ? 0 : answer - 1;
+        record.expression = readBytes();
+        record.word = readBytes();
+        return true;
+    }
+};
+
+#endif // FORMAL_LANGUAGE_TRACE_H
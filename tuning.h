@@ -0,0 +1,113 @@
+#ifndef FORMAL_LANGUAGE_TUNING_H
+#define FORMAL_LANGUAGE_TUNING_H
+
+// Параметры движков, подобранные под машину утилитой calibrate. Файл состоит из строк
+// "ключ значение", строки с '#' -- комментарии, незнакомые ключи пропускаются, так что старый
+// файл подходит новой сборке и наоборот. Программа загружает файл при запуске из --tuning FILE
+// или из переменной окружения FORMAL_LANGUAGE_TUNING; без файла действуют значения по умолчанию
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+
+#include "common.h"
+#include "input.h"
+
+struct TuningConfig {
+    // Наносекунды на одну операцию оценки QueryPlan для каждого движка: по ним сравниваются
+    // стоимости, то есть определяется, с какой длины слова автомат выгоднее Operand. У Operand
+    // подслова до 256 символов вычисляет FixedOperand, и его операции стоят отдельно; на более
+    // длинных подсловах отдельно стоят операции над списками подслов и над плотными таблицами
+    double operandSparseNanosecondsPerOp;
+    double operandDenseNanosecondsPerOp;
+    double fixedOperandNanosecondsPerOp;
+    double automatonNanosecondsPerOp;
+
+    // Доля верных ячеек таблицы подслов Operand, выше которой таблица хранится плотно, а не списком
+    double operandSparseDensity;
+
+    // Наибольшая сумма длин слов конечного языка, для которого строится индекс FiniteLanguageIndex;
+    // у больших языков и выражений со звёздочками работают остальные движки
+    double finiteLanguageLimit;
+
+    // Значения по умолчанию сняты calibrate на машине разработки
+    TuningConfig() : operandSparseNanosecondsPerOp(0.25), operandDenseNanosecondsPerOp(0.5),
+                     fixedOperandNanosecondsPerOp(2.5), automatonNanosecondsPerOp(3), operandSparseDensity(0.3),
+                     finiteLanguageLimit(100000) {}
+
+    static TuningConfig load(const string &path) {
+        MappedInput input(path.c_str());
+        TuningConfig config;
+        while (!input.finished()) {
+            string_view line = input.nextLine();
+            string_view key = MappedInput::splitToken(line);
+            if (key.empty() || key[0] == '#') {
+                continue;
+            }
+            string value(MappedInput::splitToken(line));
+            char *end = nullptr;
+            double number = std::strtod(value.c_str(), &end);
+            if (value.empty() || *end != '\0' || !(number >= 0)) {
+                throw ParseException("Invalid tuning value for " + string(key) + " in " + path);
+            }
+            if (key == "operand_sparse_ns_per_op") {
+                config.operandSparseNanosecondsPerOp = number;
+            } else if (key == "operand_dense_ns_per_op") {
+                config.operandDenseNanosecondsPerOp = number;
+            } else if (key == "fixed_operand_ns_per_op") {
+                config.fixedOperandNanosecondsPerOp = number;
+            } else if (key == "automaton_ns_per_op") {
+                config.automatonNanosecondsPerOp = number;
+            } else if (key == "operand_sparse_density") {
+                config.operandSparseDensity = number;
+            } else if (key == "finite_language_limit") {
+                config.finiteLanguageLimit = number;
+            }
+        }
+        return config;
+    }
+
+    string render() const {
+        char buffer[512];
+        std::snprintf(buffer, sizeof(buffer),
+                      "operand_sparse_ns_per_op %.6g\noperand_dense_ns_per_op %.6g\nfixed_operand_ns_per_op %.6g\n"
+                      "automaton_ns_per_op %.6g\noperand_sparse_density %.6g\nfinite_language_limit %.6g\n",
+                      operandSparseNanosecondsPerOp, operandDenseNanosecondsPerOp, fixedOperandNanosecondsPerOp,
+                      automatonNanosecondsPerOp, operandSparseDensity, finiteLanguageLimit);
+        return buffer;
+    }
+
+    // Записывает параметры в path; файл заменяется атомарно
+    void save(const string &path, const string &comment) const {
+        string temporaryPath;
+        int fd = createTemporaryFile(path, temporaryPath);
+        if (fd < 0) {
+            throw ParseException("Cannot write " + temporaryPath + ": " + std::strerror(errno));
+        }
+        bool written = writeAll(fd, "# " + comment + "\n" + render());
+        close(fd);
+        if (!written || rename(temporaryPath.c_str(), path.c_str()) != 0) {
+            unlink(temporaryPath.c_str());
+            throw ParseException("Cannot write " + path + ": " + std::strerror(errno));
+        }
+    }
+
+    // Параметры процесса: значения по умолчанию, пока install не заменил их загруженными
+    static const TuningConfig &current() {
+        return installed();
+    }
+
+    static void install(const TuningConfig &config) {
+        installed() = config;
+    }
+
+private:
+    static TuningConfig &installed() {
+        static TuningConfig config;
+        return config;
+    }
+};
+
+#endif // FORMAL_LANGUAGE_TUNING_H
@@ -0,0 +1,51 @@
+#ifndef FORMAL_LANGUAGE_WEIGHTED_OPERAND_H
+#define FORMAL_LANGUAGE_WEIGHTED_OPERAND_H
+
+// Взвешивание ответа: выражение вычисляется над полукольцом (semiring.h) теми же операндами
+// BasicOperand и той же звёздочкой BasicExpression, что и булев ответ, только вместо признака
+// "подслово подходит" в ячейке хранится сумма весов его выводов. Звёздочка считает только
+// непустые итерации, иначе у выражений вида (1+a)* выводов было бы бесконечно много. Ответ
+// на запрос -- длину -- всегда находит булев движок, а WeightedSolver взвешивает только
+// подслова этой длины
+
+#include <vector>
+
+#include "common.h"
+#include "operand.h"
+#include "semiring.h"
+
+// Веса самых длинных подходящих подслов. Веса листьев задаются по порядку листьев (букв и '1')
+// в записи выражения; без них каждый лист весит one
+template <typename Semiring>
+struct WeightedSolver {
+    typedef typename Semiring::Value Value;
+
+private:
+    string_view expression;
+    string_view word;
+    std::vector<Value> leafWeights;
+
+public:
+    WeightedSolver(string_view expression, string_view word, const std::vector<Value> &leafWeights = {}) :
+            expression(expression), word(word), leafWeights(leafWeights) {}
+
+    // Значение выражения на слове toCheck; ошибки записи -- те же, что у Expression
+    BasicOperand<Semiring> evaluate(string_view toCheck) const {
+        return BasicExpression<Semiring>(expression, leafWeights).calculateValueOfExpression(toCheck);
+    }
+
+    // Сумма (plus) весов по всем подсловам длины length, обычно равной ответу запроса;
+    // у пустого подслова вес one
+    Value weighFactors(ulong length) const {
+        if (length == 0) {
+            return Semiring::one();
+        }
+        Value total = Semiring::zero();
+        for (ulong startPosition = 0; startPosition + length <= word.length(); ++startPosition) {
+            total = Semiring::plus(total, evaluate(word.substr(startPosition, length)).wordAsSubstringWeight());
+        }
+        return total;
+    }
+};
+
+#endif // FORMAL_LANGUAGE_WEIGHTED_OPERAND_H
@@ -0,0 +1,101 @@
+#ifndef FORMAL_LANGUAGE_WORKLOAD_H
+#define FORMAL_LANGUAGE_WORKLOAD_H
+
+// Генератор воспроизводимых нагрузок: случайные выражения в обратной польской записи
+// заданного размера, глубины вложенности звёздочек и алфавита, случайные слова заданной
+// длины и распределения букв, а также примеры из README и известные тяжёлые формы выражений
+
+#include <random>
+#include <string>
+#include <vector>
+
+#include "common.h"
+
+struct WorkloadGenerator {
+private:
+    std::mt19937_64 generator;
+
+    bool coin(double probability) {
+        return std::uniform_real_distribution<double>(0.0, 1.0)(generator) < probability;
+    }
+
+    string leaf(string_view alphabet, double epsilonProbability) {
+        if (coin(epsilonProbability)) {
+            return string(1, EPSILON);
+        }
+        return string(1, alphabet[generator() % alphabet.length()]);
+    }
+
+    string build(ulong leafCount, ulong starDepth, string_view alphabet, double epsilonProbability) {
+        bool starred = starDepth > 0 && coin(STAR_PROBABILITY);
+        ulong childDepth = starred ? starDepth - 1 : starDepth;
+        string result;
+
+        if (leafCount <= 1) {
+            result = leaf(alphabet, epsilonProbability);
+        } else {
+            ulong leftLeaves = 1 + generator() % (leafCount - 1);
+            result = build(leftLeaves, childDepth, alphabet, epsilonProbability)
+                     + build(leafCount - leftLeaves, childDepth, alphabet, epsilonProbability)
+                     + (coin(UNION_PROBABILITY) ? '+' : '.');
+        }
+
+        if (starred) {
+            result += '*';
+        }
+        return result;
+    }
+
+public:
+    static constexpr double STAR_PROBABILITY = 0.3;
+    static constexpr double UNION_PROBABILITY = 0.4;
+
+    explicit WorkloadGenerator(ulong seed) : generator(seed) {}
+
+    // Случайное выражение ровно с leafCount листьями и вложенностью звёздочек не больше
+    // starDepth; буквы берутся из alphabet, лист с вероятностью epsilonProbability равен 1
+    string expression(ulong leafCount, ulong starDepth, string_view alphabet = "abc",
+                      double epsilonProbability = 0.05) {
+        return build(max(leafCount, 1UL), starDepth, alphabet, epsilonProbability);
+    }
+
+    // Случайное слово длины length; letterWeights -- относительные частоты букв a, b, c
+    string word(ulong length, const std::vector<double> &letterWeights = {1, 1, 1}) {
+        std::discrete_distribution<int> letters(letterWeights.begin(), letterWeights.end());
+        string result(length, 'a');
+        for (char &character : result) {
+            character = static_cast<char>('a' + letters(generator));
+        }
+        return result;
+    }
+
+    // Выражения из примеров README
+    static std::vector<string> readmeExpressions() {
+        return {"aab.a.*.aab.+*.ba.1+.", "bba.ab.+*b..*"};
+    }
+
+    // Цепочка звёздочек (a*)*...* глубины depth
+    static string nestedStars(ulong depth) {
+        return "a" + string(max(depth, 1UL), '*');
+    }
+
+    // Конкатенация count звёздочек a*a*...a*: много позиций с общими переходами
+    static string starConcatenation(ulong count) {
+        string result = "a*";
+        for (ulong i = 1; i < count; ++i) {
+            result += "a*.";
+        }
+        return result;
+    }
+
+    // ((a+b)*(a+b)*...)*: вложенные звёздочки над объединениями
+    static string nestedUnionStars(ulong depth) {
+        string result = "ab+*";
+        for (ulong i = 1; i < depth; ++i) {
+            result += "ab+*.*";
+        }
+        return result;
+    }
+};
+
+#endif // FORMAL_LANGUAGE_WORKLOAD_H